@@ -0,0 +1,72 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#include "background.h"
+#include <algorithm>
+#include <cstdint>
+
+static const int DEV_FACTOR=4;   // threshold in mean absolute deviations (about 3 sigma)
+static const int ALPHA_BITS=15;  // learning rate in 1.15 fixed point: |d|*alpha stays within int32
+
+// Update of an 8.8 value v towards target by alpha/2^15, rounded to nearest.
+static inline int ema(int v,int target,int alpha){ return v+(((target-v)*alpha+(1<<(ALPHA_BITS-1)))>>ALPHA_BITS); }
+
+template<int CN> static void averageRows(const cv::Mat &img,cv::Mat &mean,cv::Mat &dev,cv::Mat &fg,int alpha,int minDiff,const cv::Range &r){
+    const int cols=img.cols;
+    for(int y=r.start;y<r.end;y++){
+        const uchar *p=img.ptr<uchar>(y); uint16_t *m=mean.ptr<uint16_t>(y), *d=dev.ptr<uint16_t>(y); uchar *f=fg.ptr<uchar>(y);
+        for(int x=0;x<cols;x++,p+=CN,m+=CN){
+            int diff=0;
+            for(int c=0;c<CN;c++){
+                int v=(int)p[c]<<8, mv=m[c], a=v>mv?v-mv:mv-v;
+                diff=std::max(diff,a);
+                m[c]=(uint16_t)ema(mv,v,alpha);
+            }
+            int dv=d[x], isFg=diff>std::max(minDiff,DEV_FACTOR*dv);
+            f[x]=(uchar)(0-isFg);
+            d[x]=(uint16_t)ema(dv,diff,alpha&(isFg-1));
+        }
+    }
+}
+
+RunningAverageBackground::RunningAverageBackground(int h,double diff):history(std::max(1,h)),minDiff(diff){}
+
+void RunningAverageBackground::apply(cv::InputArray image,cv::OutputArray fgmask,double learningRate){
+    cv::Mat img=image.getMat();
+    CV_Assert(img.depth()==CV_8U&&(img.channels()==1||img.channels()==3));
+    const int cn=img.channels();
+    fgmask.create(img.size(),CV_8UC1); cv::Mat fg=fgmask.getMat();
+    if(learningRate>=1||mean.size()!=img.size()||mean.channels()!=cn){
+        img.convertTo(mean,CV_16U,256.0); dev.create(img.size(),CV_16UC1); dev.setTo(cv::Scalar(0));
+        fg.setTo(cv::Scalar(255)); frames=1;
+        return;
+    }
+    frames++;
+    double rate=learningRate>=0?learningRate:1.0/std::min(2*frames,(long)history);
+    const int alpha=std::min(1<<ALPHA_BITS,std::max(0,cvRound(rate*(1<<ALPHA_BITS)))), thr=cvRound(minDiff*256);
+    cv::parallel_for_(cv::Range(0,img.rows),[&](const cv::Range &r){
+        if(cn==3) averageRows<3>(img,mean,dev,fg,alpha,thr,r); else averageRows<1>(img,mean,dev,fg,alpha,thr,r);
+    });
+}
+
+void RunningAverageBackground::getBackgroundImage(cv::OutputArray backgroundImage) const {
+    if(mean.empty()){ backgroundImage.release(); return; }
+    mean.convertTo(backgroundImage,CV_8U,1.0/256);
+}
+
+cv::Ptr<cv::BackgroundSubtractor> createBackgroundModel(const DetectorConfig &cfg){
+    if(cfg.background==BG_AVERAGE) return cv::makePtr<RunningAverageBackground>(cfg.mogHistory,cfg.bgThreshold);
+    return cv::createBackgroundSubtractorMOG2(cfg.mogHistory,cfg.mogVarThreshold,false);
+}
+
+bool parseBackgroundKind(const std::string &name,int &kind){
+    if(name=="mog2") kind=BG_MOG2; else if(name=="average") kind=BG_AVERAGE; else return false;
+    return true;
+}
+
+const char *backgroundKindName(int kind){ return kind==BG_AVERAGE?"average":"mog2"; }
@@ -0,0 +1,36 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#ifndef BACKGROUND_H
+#define BACKGROUND_H
+#include <opencv2/opencv.hpp>
+#include "detection.h"
+
+// Background models are cv::BackgroundSubtractor implementations, so PlayerDetector takes MOG2 or
+// any other one through the same pointer. DetectorConfig::background picks one of these.
+enum BackgroundKind{ BG_MOG2=0, BG_AVERAGE=1 };
+cv::Ptr<cv::BackgroundSubtractor> createBackgroundModel(const DetectorConfig &cfg);
+// "mog2" / "average" <-> BackgroundKind, for the command line.
+bool parseBackgroundKind(const std::string &name,int &kind);
+const char *backgroundKindName(int kind);
+
+// Exponential running average for fixed cameras. Each channel keeps its mean in 8.8 fixed point
+// (16 bits) and each pixel the mean absolute deviation of its largest channel difference, learnt
+// on background pixels only. A pixel is foreground when that difference exceeds
+// max(minDiff, DEV_FACTOR * deviation). Both are updated in the same branch-free integer pass
+// over each row, which the compiler vectorises; rows are split over cv::parallel_for_.
+// apply() follows MOG2: learningRate < 0 uses 1/min(2*frames,history), >= 1 (or a new frame size)
+// re-initialises the model from the frame, and the first frame is all foreground.
+class RunningAverageBackground: public cv::BackgroundSubtractor{
+    cv::Mat mean,dev; int history; double minDiff; long frames=0;
+public:
+    explicit RunningAverageBackground(int history=500,double minDiff=20);
+    void apply(cv::InputArray image,cv::OutputArray fgmask,double learningRate=-1) override;
+    void getBackgroundImage(cv::OutputArray backgroundImage) const override;
+};
+#endif
@@ -0,0 +1,1222 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+// bench.cpp
+// Usage: ./bench [reps=30] [--only section,...] [--json results.json] [--compare baseline.json [--max-slowdown pct]]
+// Times the detection, classification, heatmap and evaluation kernels on deterministic synthetic
+// inputs and checks them against the reference paths. --json writes every timing in the layout of
+// Google Benchmark's JSON output; --compare prints the change against such a file from another build.
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <set>
+#include <string>
+#include <vector>
+#include "background.h"
+#include "classification.h"
+#include "detection.h"
+#include "detfile.h"
+#include "evaluation.h"
+#include "heatmap.h"
+
+// Counting allocator: interposes the glibc entry points so both operator new and OpenCV's
+// fastMalloc (posix_memalign) are seen. Only counts inside countAllocations().
+#if defined(__GLIBC__)
+#define HAVE_ALLOC_COUNTER 1
+extern "C"
+{
+    void *__libc_malloc(size_t);
+    void *__libc_calloc(size_t, size_t);
+    void *__libc_realloc(void *, size_t);
+    void *__libc_memalign(size_t, size_t);
+}
+static std::atomic<bool> countAllocs{false};
+static std::atomic<long> allocCalls{0};
+static std::atomic<long long> allocBytes{0};
+static inline void noteAlloc(size_t n)
+{
+    if (countAllocs.load(std::memory_order_relaxed))
+    {
+        allocCalls.fetch_add(1, std::memory_order_relaxed);
+        allocBytes.fetch_add((long long)n, std::memory_order_relaxed);
+    }
+}
+extern "C" void *malloc(size_t n) noexcept { noteAlloc(n); return __libc_malloc(n); }
+extern "C" void *calloc(size_t a, size_t b) noexcept { noteAlloc(a * b); return __libc_calloc(a, b); }
+extern "C" void *realloc(void *p, size_t n) noexcept { noteAlloc(n); return __libc_realloc(p, n); }
+extern "C" void *memalign(size_t al, size_t n) noexcept { noteAlloc(n); return __libc_memalign(al, n); }
+extern "C" void *aligned_alloc(size_t al, size_t n) noexcept { noteAlloc(n); return __libc_memalign(al, n); }
+extern "C" int posix_memalign(void **out, size_t al, size_t n) noexcept
+{
+    noteAlloc(n);
+    void *p = __libc_memalign(al, n);
+    if (!p)
+        return ENOMEM;
+    *out = p;
+    return 0;
+}
+#endif
+
+struct AllocCount
+{
+    long calls;
+    long long bytes;
+};
+
+template <typename F>
+static AllocCount countAllocations(F &&fn)
+{
+#ifdef HAVE_ALLOC_COUNTER
+    allocCalls = 0;
+    allocBytes = 0;
+    countAllocs = true;
+    fn();
+    countAllocs = false;
+    return AllocCount{allocCalls.load(), allocBytes.load()};
+#else
+    fn();
+    return AllocCount{-1, -1};
+#endif
+}
+
+// Shirt and shorts of one player centred at c, size unit s; returns the player's box.
+static cv::Rect drawPlayer(cv::Mat &f, cv::Point c, int s, int team)
+{
+    cv::Scalar shirt = team ? cv::Scalar(30, 30, 200) : cv::Scalar(220, 220, 230);
+    cv::ellipse(f, c, cv::Size(9 * s, 22 * s), 0, 0, 360, shirt, cv::FILLED);
+    cv::rectangle(f, cv::Rect(c.x - 8 * s, c.y + 10 * s, 16 * s, 12 * s), cv::Scalar(20, 20, 20), cv::FILLED);
+    return cv::Rect(c.x - 10 * s, c.y - 23 * s, 20 * s, 46 * s);
+}
+
+// Green pitch with noise, a non-green stand strip, white lines and N two-colour players.
+static cv::Mat makePitchFrame(cv::Size sz, int players, unsigned seed, std::vector<cv::Rect> *boxes = nullptr)
+{
+    cv::RNG rng(seed);
+    cv::Mat f(sz, CV_8UC3, cv::Scalar(45, 140, 50));
+    cv::Mat noise(sz, CV_8UC3);
+    rng.fill(noise, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(25));
+    f += noise;
+    cv::rectangle(f, cv::Rect(0, 0, sz.width, sz.height / 10), cv::Scalar(90, 90, 110), cv::FILLED);
+    cv::line(f, cv::Point(sz.width / 2, sz.height / 10), cv::Point(sz.width / 2, sz.height), cv::Scalar(235, 235, 235), 3);
+    cv::circle(f, cv::Point(sz.width / 2, sz.height / 2), sz.height / 6, cv::Scalar(235, 235, 235), 3);
+    const int s = std::max(1, sz.height / 1080);
+    for (int i = 0; i < players; i++)
+    {
+        cv::Point c(rng.uniform(20, sz.width - 20), rng.uniform(sz.height / 10 + 40 * s, sz.height - 40 * s));
+        cv::Rect box = drawPlayer(f, c, s, i % 2);
+        if (boxes)
+            boxes->push_back(box);
+    }
+    return f;
+}
+
+// Pre-fusion mask path kept as the reference: HSV -> field mask -> masked BGR copy -> HSV again.
+static void legacyMasks(const cv::Mat &frame, cv::Mat &field, cv::Mat &players)
+{
+    cv::Mat hsv;
+    cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV);
+    cv::Mat mask, dilated, eroded;
+    cv::inRange(hsv, cv::Scalar(40, 40, 40), cv::Scalar(90, 255, 255), mask);
+    cv::Mat k = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(5, 5));
+    cv::dilate(mask, dilated, k);
+    cv::erode(dilated, eroded, k);
+    cv::erode(eroded, eroded, k);
+    cv::erode(eroded, eroded, k);
+    cv::erode(eroded, eroded, k);
+    std::vector<std::vector<cv::Point>> cts;
+    cv::findContours(eroded, cts, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    field = cv::Mat::zeros(mask.size(), CV_8UC1);
+    for (size_t i = 0; i < cts.size(); i++)
+        if (cv::contourArea(cts[i]) > 1000.0)
+            cv::drawContours(field, cts, (int)i, cv::Scalar(255), cv::FILLED);
+    cv::Mat maskedBgr = cv::Mat::zeros(frame.size(), frame.type());
+    frame.copyTo(maskedBgr, field);
+    cv::Mat hsv2, green, black;
+    cv::cvtColor(maskedBgr, hsv2, cv::COLOR_BGR2HSV);
+    cv::inRange(hsv2, cv::Scalar(40, 40, 40), cv::Scalar(90, 255, 255), green);
+    cv::inRange(hsv2, cv::Scalar(0, 0, 0), cv::Scalar(10, 10, 10), black);
+    cv::bitwise_or(green, black, players);
+    cv::bitwise_not(players, players);
+    int d = 5;
+    cv::Mat elem = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2 * d + 1, 2 * d + 1), cv::Point(d, d));
+    cv::dilate(players, players, elem);
+}
+
+// Pre-batching jersey feature: per-ROI resize, two conversions, float copy and a full sort by norm.
+static cv::Vec3f legacyAvgNonGreenLab(const cv::Mat &roi)
+{
+    cv::Mat hsv;
+    cv::cvtColor(roi, hsv, cv::COLOR_BGR2HSV);
+    cv::Mat g;
+    cv::inRange(hsv, cv::Scalar(35, 40, 40), cv::Scalar(90, 255, 255), g);
+    cv::Mat lab;
+    cv::cvtColor(roi, lab, cv::COLOR_BGR2Lab);
+    lab.convertTo(lab, CV_32F);
+    cv::Mat r = lab.reshape(1, lab.rows * lab.cols);
+    std::vector<cv::Vec3f> v;
+    v.reserve(r.rows);
+    for (int i = 0; i < r.rows; i++)
+        if (g.at<uchar>(i) == 0)
+            v.push_back(r.at<cv::Vec3f>(i));
+    if (v.empty())
+        return cv::Vec3f(0, 0, 0);
+    std::sort(v.begin(), v.end(), [](const cv::Vec3f &a, const cv::Vec3f &b) { return cv::norm(a) > cv::norm(b); });
+    int n = (int)std::min<size_t>(v.size(), 500);
+    cv::Vec3f s(0, 0, 0);
+    for (int i = 0; i < n; i++)
+        s += v[i];
+    return s * (1.0f / n);
+}
+
+static void legacyFeatures(const cv::Mat &frame, const std::vector<cv::Rect> &boxes, std::vector<cv::Vec3f> &feats)
+{
+    feats.clear();
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        cv::Rect sb = boxes[i] & cv::Rect(0, 0, frame.cols, frame.rows);
+        if (sb.area() <= 0)
+        {
+            feats.push_back(cv::Vec3f(0, 0, 0));
+            continue;
+        }
+        cv::Mat roi = frame(sb);
+        cv::resize(roi, roi, cv::Size(32, 64));
+        feats.push_back(legacyAvgNonGreenLab(roi));
+    }
+}
+
+// Pre-grid mergeBoxes kept as the golden reference.
+static std::vector<cv::Rect> legacyMergeBoxes(const std::vector<cv::Rect> &inputBoxes)
+{
+    std::vector<cv::Rect> merged;
+    std::vector<bool> used(inputBoxes.size(), false);
+    for (size_t i = 0; i < inputBoxes.size(); i++)
+    {
+        if (used[i])
+            continue;
+        cv::Rect cur = inputBoxes[i];
+        bool changed;
+        do
+        {
+            changed = false;
+            for (size_t j = 0; j < inputBoxes.size(); j++)
+            {
+                if (i == j || used[j])
+                    continue;
+                cv::Rect o = inputBoxes[j];
+                if ((cur & o).area() > 0 || cur.contains(o.tl()) || cur.contains(o.br()) || o.contains(cur.tl()) || o.contains(cur.br()))
+                {
+                    cur = cur | o;
+                    used[j] = true;
+                    changed = true;
+                }
+            }
+        } while (changed);
+        merged.push_back(cur);
+        used[i] = true;
+    }
+    std::vector<cv::Rect> cleaned;
+    for (size_t i = 0; i < merged.size(); i++)
+    {
+        bool inside = false;
+        for (size_t j = 0; j < merged.size(); j++)
+        {
+            if (i == j)
+                continue;
+            if (merged[j].contains(merged[i].tl()) && merged[j].contains(merged[i].br()))
+            {
+                inside = true;
+                break;
+            }
+        }
+        if (!inside)
+            cleaned.push_back(merged[i]);
+    }
+    return cleaned;
+}
+
+// Full-frame heatmap accumulation kept as the golden reference for Heatmap::update.
+static void legacyHeatmapUpdate(cv::Mat &accum, const cv::Mat &frame, const std::vector<ClassifiedPlayer> &classified)
+{
+    const cv::Scalar colors[3] = {cv::Scalar(0, 0, 255), cv::Scalar(255, 0, 0), cv::Scalar(0, 255, 0)};
+    if (accum.empty())
+        accum = cv::Mat::zeros(frame.size(), CV_32FC3);
+    for (size_t i = 0; i < classified.size(); i++)
+    {
+        cv::Mat t = cv::Mat::zeros(frame.size(), CV_32FC3);
+        int team = classified[i].team;
+        if (team < 0 || team >= 3)
+            team = 2;
+        cv::Point c = (classified[i].box.tl() + classified[i].box.br()) * 0.5;
+        cv::circle(t, c, 20, colors[team], -1, cv::LINE_AA);
+        accum += t;
+    }
+}
+
+// Pre-engine eval.cpp matching (std::map per frame, single thread) kept as the golden reference.
+static double legacyIou(const EvalBox &a, const EvalBox &b)
+{
+    const double x1 = std::max(a.x1, b.x1), y1 = std::max(a.y1, b.y1);
+    const double x2 = std::min(a.x2, b.x2), y2 = std::min(a.y2, b.y2);
+    const double inter = std::max(0.0, x2 - x1) * std::max(0.0, y2 - y1);
+    const double a1 = std::max(0.0, a.x2 - a.x1) * std::max(0.0, a.y2 - a.y1);
+    const double a2 = std::max(0.0, b.x2 - b.x1) * std::max(0.0, b.y2 - b.y1);
+    const double uni = a1 + a2 - inter;
+    return uni > 0 ? inter / uni : 0.0;
+}
+
+static EvalCounts legacyEvaluate(std::map<int, std::vector<EvalBox>> ours, std::map<int, std::vector<EvalBox>> yolo, double thr)
+{
+    EvalCounts c;
+    std::vector<double> matched;
+    std::set<int> frames;
+    for (auto &kv : ours)
+        frames.insert(kv.first);
+    for (auto &kv : yolo)
+        frames.insert(kv.first);
+    for (int f : frames)
+    {
+        auto &P = ours[f];
+        auto &G = yolo[f];
+        std::vector<char> used(G.size(), 0);
+        for (const auto &pb : P)
+        {
+            double best = 0.0;
+            int best_j = -1;
+            for (int j = 0; j < (int)G.size(); ++j)
+            {
+                if (used[j])
+                    continue;
+                double v = legacyIou(pb, G[j]);
+                if (v > best)
+                {
+                    best = v;
+                    best_j = j;
+                }
+            }
+            if (best >= thr)
+            {
+                c.tp++;
+                used[best_j] = 1;
+                matched.push_back(best);
+            }
+            else
+                c.fp++;
+        }
+        for (int j = 0; j < (int)G.size(); ++j)
+            if (!used[j])
+                c.fn++;
+    }
+    c.iouSum = std::accumulate(matched.begin(), matched.end(), 0.0);
+    return c;
+}
+
+// n random player-sized boxes spread over a square whose side grows with sqrt(n); spacing sets
+// how crowded the set is. With lattice > 1 coordinates and sizes snap to that step, which makes
+// exact corner and edge contacts common.
+static std::vector<cv::Rect> randomBoxes(int n, double spacing, int lattice, unsigned seed)
+{
+    cv::RNG rng(seed);
+    const int side = std::max(1, (int)(std::sqrt((double)n) * spacing));
+    std::vector<cv::Rect> out;
+    out.reserve(n);
+    for (int i = 0; i < n; i++)
+    {
+        int x = rng.uniform(0, side) / lattice * lattice, y = rng.uniform(0, side) / lattice * lattice;
+        int w = std::max(lattice, rng.uniform(10, 50) / lattice * lattice), h = std::max(lattice, rng.uniform(20, 90) / lattice * lattice);
+        out.push_back(cv::Rect(x, y, w, h));
+    }
+    return out;
+}
+
+// One named timing. items is the number of kernel calls made by one timed call.
+struct BenchResult
+{
+    std::string name;
+    int reps;
+    long items;
+    double medianMs, meanMs, minMs, maxMs;
+};
+static std::vector<BenchResult> results;
+
+// Warm-up call (sizes the reusable buffers), then reps timed calls; records and returns the median.
+template <typename F>
+static double timeMs(const std::string &name, int reps, F &&fn, long items = 1)
+{
+    fn();
+    std::vector<double> t;
+    t.reserve(reps);
+    for (int i = 0; i < reps; i++)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        t.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    }
+    std::sort(t.begin(), t.end());
+    BenchResult r{name, reps, items, t[t.size() / 2], std::accumulate(t.begin(), t.end(), 0.0) / t.size(), t.front(), t.back()};
+    results.push_back(r);
+    return r.medianMs;
+}
+
+static std::string sizeName(const cv::Size &sz)
+{
+    return std::to_string(sz.width) + "x" + std::to_string(sz.height);
+}
+
+static bool sameMask(const cv::Mat &a, const cv::Mat &b)
+{
+    return a.size() == b.size() && a.type() == b.type() && cv::norm(a, b, cv::NORM_INF) == 0;
+}
+
+static bool benchMasks(int reps)
+{
+    bool ok = true;
+    const cv::Size sizes[] = {cv::Size(1280, 720), cv::Size(1920, 1080), cv::Size(3840, 2160)};
+    std::cout << "masks: legacy two-HSV path vs fused single-pass kernel (median ms/frame)\n";
+    for (const cv::Size &sz : sizes)
+    {
+        cv::Mat frame = makePitchFrame(sz, 22, 7);
+        cv::Mat f0, p0, f1, p1;
+        double legacy = timeMs("masks/legacy/" + sizeName(sz), reps, [&] { legacyMasks(frame, f0, p0); });
+        PlayerDetector det;
+        double fused = timeMs("masks/fused/" + sizeName(sz), reps, [&] { det.computeMasks(frame); });
+        f1 = det.fieldMask();
+        p1 = det.playersMask();
+        bool same = sameMask(f0, f1) && sameMask(p0, p1);
+        ok = ok && same;
+        std::cout << "  " << std::setw(4) << sz.width << "x" << std::setw(4) << std::left << sz.height << std::right
+                  << std::fixed << std::setprecision(2)
+                  << "  legacy " << std::setw(8) << legacy
+                  << "  fused " << std::setw(8) << fused
+                  << "  saved " << std::setw(8) << (legacy - fused)
+                  << "  speedup " << std::setprecision(2) << (fused > 0 ? legacy / fused : 0.0) << "x"
+                  << "  identical=" << (same ? "yes" : "NO") << "\n";
+    }
+    return ok;
+}
+
+// The stages inside computeMasks and the per-tile jersey feature on their own. Re-running a mask
+// step on the same colour masks must reproduce what computeMasks produced.
+static bool benchKernels(int reps)
+{
+    bool ok = true;
+    const cv::Size sizes[] = {cv::Size(1280, 720), cv::Size(1920, 1080), cv::Size(3840, 2160)};
+    std::cout << "kernels: mask steps after the colour pass (median ms/frame)\n";
+    for (const cv::Size &sz : sizes)
+    {
+        cv::Mat frame = makePitchFrame(sz, 22, 7);
+        PlayerDetector det;
+        det.computeMasks(frame);
+        cv::Mat field = det.fieldMask().clone(), players = det.playersMask().clone();
+        double fieldMs = timeMs("maskGreenField/" + sizeName(sz), reps, [&] { det.maskGreenField(); });
+        double playersMs = timeMs("maskGreenPlayers/" + sizeName(sz), reps, [&] { det.maskGreenPlayers(frame); });
+        bool same = sameMask(field, det.fieldMask()) && sameMask(players, det.playersMask());
+        ok = ok && same;
+        std::cout << "  " << std::setw(4) << sz.width << "x" << std::setw(4) << std::left << sz.height << std::right
+                  << std::fixed << std::setprecision(3)
+                  << "  maskGreenField " << std::setw(8) << fieldMs
+                  << "  maskGreenPlayers " << std::setw(8) << playersMs
+                  << "  repeatable=" << (same ? "yes" : "NO") << "\n";
+    }
+    // Tiles prepared one by one must give the features extractFeatures computes on its strip.
+    std::vector<cv::Rect> boxes;
+    cv::Mat frame = makePitchFrame(cv::Size(1920, 1080), 40, 11, &boxes);
+    std::vector<cv::Mat> labs, greens;
+    for (const cv::Rect &b : boxes)
+    {
+        cv::Mat tile, hsv, lab, green;
+        cv::resize(frame(b & cv::Rect(0, 0, frame.cols, frame.rows)), tile, cv::Size(32, 64));
+        cv::cvtColor(tile, hsv, cv::COLOR_BGR2HSV);
+        cv::inRange(hsv, cv::Scalar(35, 40, 40), cv::Scalar(90, 255, 255), green);
+        cv::cvtColor(tile, lab, cv::COLOR_BGR2Lab);
+        labs.push_back(lab);
+        greens.push_back(green);
+    }
+    std::vector<uint32_t> keys;
+    std::vector<cv::Vec3f> perTile(boxes.size()), batched;
+    double ms = timeMs("avgNonGreenLab/tiles=" + std::to_string(boxes.size()), reps, [&] {
+        for (size_t i = 0; i < boxes.size(); i++)
+            perTile[i] = avgNonGreenLab(labs[i], greens[i], keys);
+    }, (long)boxes.size());
+    TeamClassifier cls;
+    cls.extractFeatures(frame, boxes, batched);
+    bool same = perTile == batched;
+    ok = ok && same;
+    std::cout << "  avgNonGreenLab " << std::setprecision(2) << ms * 1000.0 / boxes.size() << " us/tile over " << boxes.size()
+              << " tiles  identical=" << (same ? "yes" : "NO") << "\n";
+    return ok;
+}
+
+// A short clip: 22 players running over a static pitch, then the camera tilting from frame
+// tiltFrom on. Player sizes and speeds scale with the frame height. truth receives the players'
+// boxes of every frame (clipped to it).
+static std::vector<cv::Mat> makeTiltClip(cv::Size sz, int frames, int tiltFrom, std::vector<std::vector<cv::Rect>> *truth = nullptr)
+{
+    const int s = std::max(1, sz.height / 1080), tiltStep = 4 * s;
+    cv::Mat pitch = makePitchFrame(cv::Size(sz.width, sz.height + tiltStep * frames), 0, 5);
+    cv::RNG rng(9);
+    std::vector<cv::Point2f> pos, vel;
+    for (int i = 0; i < 22; i++)
+    {
+        pos.push_back(cv::Point2f(rng.uniform(100.f * s, sz.width - 100.f * s), rng.uniform(250.f * s, sz.height - 100.f * s)));
+        vel.push_back(cv::Point2f(rng.uniform(-4.f, 4.f) * s, rng.uniform(-3.f, 3.f) * s));
+    }
+    std::vector<cv::Mat> clip;
+    for (int k = 0; k < frames; k++)
+    {
+        int tilt = std::max(0, k - tiltFrom) * tiltStep;
+        cv::Mat f = pitch(cv::Rect(0, tilt, sz.width, sz.height)).clone();
+        std::vector<cv::Rect> boxes;
+        for (size_t i = 0; i < pos.size(); i++)
+        {
+            cv::Rect b = drawPlayer(f, cv::Point(cvRound(pos[i].x + vel[i].x * k), cvRound(pos[i].y + vel[i].y * k)), s, (int)(i % 2));
+            b &= cv::Rect(0, 0, sz.width, sz.height);
+            if (b.area() > 0)
+                boxes.push_back(b);
+        }
+        if (truth)
+            truth->push_back(boxes);
+        clip.push_back(f);
+    }
+    return clip;
+}
+
+// The tilt clip at 1080p (camera moving from frame 40). The incremental detector must give the full detector's boxes on every frame where its cached
+// field mask equals the freshly computed one (the jersey and combined masks are exact there).
+static bool benchIncremental()
+{
+    const int frames = 60;
+    std::vector<cv::Mat> clip = makeTiltClip(cv::Size(1920, 1080), frames, 40);
+    DetectorConfig inc;
+    inc.fieldRefresh = 10;
+    PlayerDetector full, incremental(inc);
+    std::vector<cv::Rect> a, b;
+    int sameField = 0, mismatched = 0;
+    for (const cv::Mat &f : clip)
+    {
+        full.detect(f, a);
+        incremental.detect(f, b);
+        if (sameMask(full.fieldMask(), incremental.fieldMask()))
+        {
+            sameField++;
+            if (a != b)
+                mismatched++;
+        }
+    }
+    const DetectorStats &st = incremental.stats();
+    PlayerDetector fullTimed, incTimed(inc);
+    size_t k = 0;
+    double fullMs = timeMs("detect/full/1920x1080", frames - 1, [&] { fullTimed.detect(clip[k++], a); });
+    k = 0;
+    double incMs = timeMs("detect/incremental/1920x1080", frames - 1, [&] { incTimed.detect(clip[k++], b); });
+    bool ok = mismatched == 0;
+    std::cout << "incremental: full vs field_refresh=10 detection on a " << frames << "-frame 1920x1080 clip (median ms/frame)\n"
+              << std::fixed << std::setprecision(3) << "  full " << fullMs << "  incremental " << incMs << "  speedup "
+              << std::setprecision(2) << (incMs > 0 ? fullMs / incMs : 0.0) << "x\n"
+              << "  field recomputed on " << st.fieldRefreshes << " frames (" << st.motionRefreshes << " on camera motion), jersey mask on "
+              << std::setprecision(1) << (st.tiles ? 100.0 * st.activeTiles / st.tiles : 0.0) << "% of tiles\n"
+              << "  cached field identical on " << sameField << "/" << frames << " frames, boxes "
+              << (ok ? "identical on all of them" : "DIFFER on " + std::to_string(mismatched)) << "\n";
+    return ok;
+}
+
+// Band mode must reproduce single-band detection exactly: every mask and the boxes of every frame
+// of the tilt clip, and the boxes of random frames full of shapes that cross band seams (rings
+// with blobs in their holes, spirals, bars spanning several bands). A fresh detector sees the
+// first frame as all foreground, so those boxes come straight from the jersey mask.
+static bool benchBands(int reps)
+{
+    bool ok = true;
+    std::cout << "bands: row-band parallel detection vs single band (" << cv::getNumThreads() << " threads)\n";
+    const int frames = 30;
+    std::vector<cv::Mat> clip = makeTiltClip(cv::Size(1920, 1080), frames, 15);
+    for (int n : {2, 5, -1})
+    {
+        DetectorConfig cfg;
+        cfg.bands = n;
+        PlayerDetector full, banded(cfg);
+        std::vector<cv::Rect> a, b;
+        int differ = 0;
+        for (const cv::Mat &f : clip)
+        {
+            full.detect(f, a);
+            banded.detect(f, b);
+            if (a != b || !sameMask(full.fieldMask(), banded.fieldMask()) || !sameMask(full.playersMask(), banded.playersMask()))
+                differ++;
+        }
+        ok = ok && differ == 0;
+        std::cout << "  tilt clip 1920x1080, bands=" << n << ": masks and boxes "
+                  << (differ ? "DIFFER on " + std::to_string(differ) + " frames" : "identical on all " + std::to_string(frames) + " frames") << "\n";
+    }
+    const cv::Size small(640, 360);
+    const int stressFrames = 200;
+    int differ = 0;
+    long boxes = 0;
+    for (int k = 0; k < stressFrames; k++)
+    {
+        cv::RNG rng(1000 + k);
+        cv::Mat f(small, CV_8UC3, cv::Scalar(45, 140, 50));
+        for (int i = 0; i < 12; i++)
+        {
+            cv::Scalar colour = i % 2 ? cv::Scalar(30, 30, 200) : cv::Scalar(220, 220, 230);
+            cv::Point c(rng.uniform(0, small.width), rng.uniform(0, small.height));
+            switch (rng.uniform(0, 4))
+            {
+            case 0: // ring with a blob in its hole
+                cv::circle(f, c, rng.uniform(22, 40), colour, rng.uniform(2, 5));
+                cv::ellipse(f, c, cv::Size(rng.uniform(3, 8), rng.uniform(6, 12)), 0, 0, 360, colour, cv::FILLED);
+                break;
+            case 1: // open arc: a U that only closes up across a seam
+                cv::ellipse(f, c, cv::Size(rng.uniform(15, 40), rng.uniform(15, 60)), rng.uniform(0, 360), 0, rng.uniform(180, 330), colour, 3);
+                break;
+            case 2: // tall bar over several bands
+                cv::rectangle(f, cv::Rect(c.x, c.y, rng.uniform(6, 20), rng.uniform(30, 150)), colour, cv::FILLED);
+                break;
+            default:
+                drawPlayer(f, c, 1, i % 2);
+            }
+        }
+        DetectorConfig cfg;
+        cfg.bands = 7;
+        PlayerDetector full, banded(cfg);
+        std::vector<cv::Rect> a, b;
+        full.detect(f, a);
+        banded.detect(f, b);
+        boxes += (long)a.size();
+        if (a != b || !sameMask(full.playersMask(), banded.playersMask()))
+            differ++;
+    }
+    ok = ok && differ == 0 && boxes > 0;
+    std::cout << "  " << stressFrames << " random " << sizeName(small) << " frames, bands=7: " << boxes << " boxes, "
+              << (differ ? "DIFFER on " + std::to_string(differ) + " frames" : "identical") << "\n";
+    std::vector<cv::Mat> clip4k = makeTiltClip(cv::Size(3840, 2160), 12, 12);
+    std::vector<cv::Rect> out;
+    std::cout << "  3840x2160 (median ms/frame)" << std::fixed << std::setprecision(2);
+    for (int n : {1, 2, 4, cv::getNumThreads()})
+    {
+        DetectorConfig cfg;
+        cfg.bands = n;
+        PlayerDetector det(cfg);
+        for (const cv::Mat &f : clip4k)
+            det.detect(f, out); // let the background model settle
+        size_t k = 0;
+        double ms = timeMs(n == 1 ? std::string("detect/full/3840x2160") : "detect/bands=" + std::to_string(n) + "/3840x2160", reps,
+                           [&] { det.detect(clip4k[k++ % clip4k.size()], out); });
+        std::cout << "  " << (n == 1 ? std::string("full") : "bands=" + std::to_string(n)) << " " << ms;
+    }
+    std::cout << "\n";
+    return ok;
+}
+
+// Plain per-pixel, single-threaded version of RunningAverageBackground's update, to check the
+// row-parallel kernel against (same fixed-point arithmetic, no shortcuts).
+struct ReferenceAverage
+{
+    std::vector<int> mean, dev;
+    cv::Size size;
+    long frames = 0;
+    void apply(const cv::Mat &img, cv::Mat &fg, double lr, int history, double minDiff)
+    {
+        fg.create(img.size(), CV_8UC1);
+        if (img.size() != size)
+        {
+            size = img.size();
+            mean.assign((size_t)img.total() * 3, 0);
+            dev.assign(img.total(), 0);
+            for (size_t i = 0; i < mean.size(); i++)
+                mean[i] = img.data[i] << 8;
+            fg.setTo(cv::Scalar(255));
+            frames = 1;
+            return;
+        }
+        frames++;
+        double rate = lr >= 0 ? lr : 1.0 / std::min(2 * frames, (long)history);
+        int alpha = std::min(32768, std::max(0, cvRound(rate * 32768))), thr = cvRound(minDiff * 256);
+        for (size_t i = 0; i < img.total(); i++)
+        {
+            int diff = 0;
+            for (int c = 0; c < 3; c++)
+            {
+                int v = img.data[i * 3 + c] << 8, &m = mean[i * 3 + c];
+                diff = std::max(diff, std::abs(v - m));
+                m += ((v - m) * alpha + 16384) >> 15;
+            }
+            bool isFg = diff > std::max(thr, 4 * dev[i]);
+            fg.data[i] = isFg ? 255 : 0;
+            if (!isFg)
+                dev[i] += ((diff - dev[i]) * alpha + 16384) >> 15;
+        }
+    }
+};
+
+static FrameBoxes toFrameBoxes(const std::vector<std::vector<cv::Rect>> &frames)
+{
+    FrameBoxes out;
+    out.start.assign(1, 0);
+    std::vector<EvalBox> eb;
+    for (const std::vector<cv::Rect> &f : frames)
+    {
+        eb.clear();
+        for (const cv::Rect &b : f)
+            eb.push_back(EvalBox{(double)b.x, (double)b.y, (double)b.br().x, (double)b.br().y});
+        out.appendFrame(eb.data(), (int)eb.size());
+    }
+    return out;
+}
+
+// MOG2 against the running-average model (background.h) on a fixed-camera clip: the fixed-point
+// kernel must equal the plain reference on every frame; apply() cost and detection accuracy
+// against the drawn players are reported for both.
+static bool benchBackground(int reps)
+{
+    std::vector<std::vector<cv::Rect>> truth;
+    const int frames = 80;
+    std::vector<cv::Mat> clip = makeTiltClip(cv::Size(1920, 1080), frames, frames, &truth);
+    DetectorConfig cfg;
+    RunningAverageBackground model(cfg.mogHistory, cfg.bgThreshold);
+    ReferenceAverage ref;
+    cv::Mat a, b, bgA;
+    int differ = 0;
+    for (const cv::Mat &f : clip)
+    {
+        model.apply(f, a, cfg.learningRate);
+        ref.apply(f, b, cfg.learningRate, cfg.mogHistory, cfg.bgThreshold);
+        if (!sameMask(a, b))
+            differ++;
+    }
+    model.getBackgroundImage(bgA);
+    cv::Mat bgRef(clip[0].size(), CV_8UC3);
+    for (size_t i = 0; i < ref.mean.size(); i++)
+        bgRef.data[i] = cv::saturate_cast<uchar>(ref.mean[i] / 256.0);
+    const bool ok = differ == 0 && sameMask(bgA, bgRef);
+    std::cout << "background: MOG2 vs running average (median ms/frame)\n"
+              << "  fixed-point kernel vs reference over " << frames << " frames: "
+              << (ok ? "identical" : "DIFFER on " + std::to_string(differ) + " frames") << "\n";
+
+    const cv::Size sizes[] = {cv::Size(960, 540), cv::Size(1920, 1080)};
+    for (const cv::Size &sz : sizes)
+    {
+        std::vector<cv::Mat> scaled(clip.size());
+        for (size_t i = 0; i < clip.size(); i++)
+            cv::resize(clip[i], scaled[i], sz, 0, 0, cv::INTER_AREA);
+        double ms[2];
+        for (int kind = BG_MOG2; kind <= BG_AVERAGE; kind++)
+        {
+            DetectorConfig c;
+            c.background = kind;
+            cv::Ptr<cv::BackgroundSubtractor> bg = createBackgroundModel(c);
+            cv::Mat fg;
+            for (int i = 0; i < 20; i++)
+                bg->apply(scaled[i], fg, c.learningRate);
+            size_t k = 20;
+            ms[kind] = timeMs(std::string("background/") + backgroundKindName(kind) + "/" + sizeName(sz), reps,
+                              [&] { bg->apply(scaled[k++ % scaled.size()], fg, c.learningRate); });
+        }
+        std::cout << "  " << std::setw(4) << sz.width << "x" << std::setw(4) << std::left << sz.height << std::right
+                  << std::fixed << std::setprecision(3) << "  mog2 " << std::setw(8) << ms[BG_MOG2]
+                  << "  average " << std::setw(8) << ms[BG_AVERAGE] << "  speedup " << std::setprecision(2)
+                  << (ms[BG_AVERAGE] > 0 ? ms[BG_MOG2] / ms[BG_AVERAGE] : 0.0) << "x\n";
+    }
+
+    // Accuracy: whole detector, first 10 frames (model warm-up) left out.
+    const int skip = 10;
+    FrameBoxes gt = toFrameBoxes(std::vector<std::vector<cv::Rect>>(truth.begin() + skip, truth.end()));
+    for (int kind = BG_MOG2; kind <= BG_AVERAGE; kind++)
+    {
+        DetectorConfig c;
+        c.background = kind;
+        PlayerDetector det(c);
+        std::vector<std::vector<cv::Rect>> found;
+        std::vector<cv::Rect> out;
+        for (int i = 0; i < frames; i++)
+        {
+            det.detect(clip[i], out);
+            if (i >= skip)
+                found.push_back(out);
+        }
+        EvalCounts e = evaluate(toFrameBoxes(found), gt, std::vector<double>(1, 0.5))[0];
+        std::cout << "  detection vs drawn players, " << std::setw(7) << std::left << backgroundKindName(kind) << std::right
+                  << std::setprecision(3) << " P=" << e.precision() << " R=" << e.recall() << " F1=" << e.f1()
+                  << " mIoU=" << e.meanIou() << "\n";
+    }
+    return ok;
+}
+
+static bool benchMergeBoxes(int reps)
+{
+    bool ok = true;
+    PlayerDetector det;
+    std::vector<cv::Rect> out;
+    int checked = 0, mismatched = 0;
+    for (int t = 0; t < 2000; t++)
+    {
+        std::vector<cv::Rect> in = randomBoxes(1 + t % 150, (t % 4 == 0) ? 25.0 : 70.0, (t % 3 == 0) ? 10 : 1, 1000 + t);
+        det.mergeBoxes(in, out);
+        checked++;
+        if (out != legacyMergeBoxes(in))
+            mismatched++;
+    }
+    ok = mismatched == 0;
+    std::cout << "mergeBoxes: golden check vs legacy on " << checked << " random sets: "
+              << (ok ? "identical" : "MISMATCH") << " (" << mismatched << " differ)\n";
+    std::cout << "mergeBoxes: legacy all-pairs vs spatial grid (median ms/call)\n";
+    const int sizes[] = {10, 100, 1000, 10000};
+    const double spacings[] = {70.0, 25.0};
+    for (double spacing : spacings)
+        for (int n : sizes)
+        {
+            std::vector<cv::Rect> in = randomBoxes(n, spacing, 1, 42);
+            const int r = n >= 1000 ? std::max(1, reps / 10) : reps;
+            std::vector<cv::Rect> ref;
+            const std::string tag = std::string(spacing < 50 ? "crowded" : "spread") + "/n=" + std::to_string(n);
+            double legacy = timeMs("mergeBoxes/legacy/" + tag, r, [&] { ref = legacyMergeBoxes(in); });
+            double grid = timeMs("mergeBoxes/grid/" + tag, r, [&] { det.mergeBoxes(in, out); });
+            bool same = ref == out;
+            ok = ok && same;
+            std::cout << "  " << (spacing < 50 ? "crowded" : "spread ") << " n=" << std::setw(5) << std::left << n << std::right
+                      << std::fixed << std::setprecision(3)
+                      << "  legacy " << std::setw(10) << legacy
+                      << "  grid " << std::setw(8) << grid
+                      << "  speedup " << std::setprecision(1) << (grid > 0 ? legacy / grid : 0.0) << "x"
+                      << "  merged=" << out.size() << "  identical=" << (same ? "yes" : "NO") << "\n";
+        }
+    return ok;
+}
+
+static bool benchFeatures(int reps)
+{
+    std::cout << "features: per-ROI legacy vs batched extractor, 1920x1080 (median ms/frame)\n";
+    bool ok = true;
+    const int counts[] = {12, 24, 40};
+    for (int players : counts)
+    {
+        std::vector<cv::Rect> boxes;
+        cv::Mat frame = makePitchFrame(cv::Size(1920, 1080), players, 11, &boxes);
+        TeamClassifier cls;
+        std::vector<cv::Vec3f> a, b;
+        const std::string tag = "players=" + std::to_string(players);
+        double legacy = timeMs("features/legacy/" + tag, reps, [&] { legacyFeatures(frame, boxes, a); });
+        double batched = timeMs("features/batched/" + tag, reps, [&] { cls.extractFeatures(frame, boxes, b); });
+        double classify = timeMs("classify/" + tag, reps, [&] { cls.classify(frame, boxes); });
+        // Equal-norm ties at the top-500 cut may pick different pixels, each worth at most 255/500.
+        double maxDiff = 0;
+        for (size_t i = 0; i < a.size(); i++)
+            for (int c = 0; c < 3; c++)
+                maxDiff = std::max(maxDiff, (double)std::fabs(a[i][c] - b[i][c]));
+        bool same = a.size() == b.size() && maxDiff <= 1.0;
+        ok = ok && same;
+        std::cout << "  players=" << std::setw(3) << std::left << players << std::right
+                  << std::fixed << std::setprecision(3)
+                  << "  legacy " << std::setw(8) << legacy
+                  << "  batched " << std::setw(8) << batched
+                  << "  speedup " << std::setprecision(1) << (batched > 0 ? legacy / batched : 0.0) << "x"
+                  << std::setprecision(3) << "  classify() total " << std::setw(8) << classify
+                  << "  max |diff| " << std::setprecision(2) << maxDiff << (same ? "" : "  MISMATCH") << "\n";
+    }
+    return ok;
+}
+
+static bool benchHeatmap(int reps)
+{
+    std::cout << "heatmap: full-frame legacy vs stamped update, 1920x1080 (median ms/frame)\n";
+    bool ok = true;
+    const cv::Size sz(1920, 1080);
+    const int counts[] = {5, 20, 40};
+    for (int players : counts)
+    {
+        cv::Mat frame(sz, CV_8UC3, cv::Scalar(40, 140, 40));
+        // Jittered copies of one box set, some hanging off the frame edges, with mixed team labels.
+        cv::RNG rng(17 + players);
+        std::vector<ClassifiedPlayer> cp(players);
+        for (auto &p : cp)
+        {
+            p.box = cv::Rect(rng.uniform(-30, sz.width - 10), rng.uniform(-60, sz.height - 20), rng.uniform(15, 60), rng.uniform(30, 120));
+            p.team = rng.uniform(-1, 3);
+            p.trackId = -1;
+        }
+        const int steps = 100;
+        std::vector<std::vector<ClassifiedPlayer>> seq(steps, cp);
+        for (int s = 1; s < steps; s++)
+            for (auto &p : seq[s])
+                p.box += cv::Point(rng.uniform(-8, 9), rng.uniform(-8, 9)) * s / 4;
+
+        cv::Mat accum;
+        Heatmap hm;
+        for (const auto &f : seq)
+        {
+            legacyHeatmapUpdate(accum, frame, f);
+            hm.update(frame, f);
+        }
+        bool same = cv::norm(accum, hm.accumulated(), cv::NORM_INF) == 0;
+        // Sliding window: subtracting the first half must leave exactly the second half.
+        Heatmap win, tail;
+        std::vector<HeatSplat> older;
+        for (int s = 0; s < steps; s++)
+        {
+            win.update(frame, seq[s], s < steps / 2 ? &older : nullptr);
+            if (s >= steps / 2)
+                tail.update(frame, seq[s]);
+        }
+        win.subtract(older);
+        bool windowSame = cv::norm(win.accumulated(), tail.accumulated(), cv::NORM_INF) == 0;
+        ok = ok && same && windowSame;
+
+        cv::Mat scratch;
+        Heatmap timed;
+        size_t k = 0;
+        const std::string tag = "players=" + std::to_string(players);
+        double legacy = timeMs("heatmap/legacy/" + tag, reps, [&] { legacyHeatmapUpdate(scratch, frame, seq[k++ % steps]); });
+        k = 0;
+        double stamped = timeMs("heatmap/stamped/" + tag, reps, [&] { timed.update(frame, seq[k++ % steps]); });
+        std::cout << "  players=" << std::setw(3) << std::left << players << std::right
+                  << std::fixed << std::setprecision(3)
+                  << "  legacy " << std::setw(8) << legacy
+                  << "  stamped " << std::setw(8) << stamped
+                  << "  speedup " << std::setprecision(1) << (stamped > 0 ? legacy / stamped : 0.0) << "x"
+                  << "  identical=" << (same ? "yes" : "NO") << "  window=" << (windowSame ? "exact" : "MISMATCH") << "\n";
+    }
+    return ok;
+}
+
+// Prediction/ground-truth pair for a synthetic match: ground truth is a random crowd per frame,
+// predictions are a jittered subset plus false alarms. Both are returned in both layouts.
+static void makeEvalSet(int frames, unsigned seed, std::map<int, std::vector<EvalBox>> &pm, std::map<int, std::vector<EvalBox>> &gm,
+                        FrameBoxes &pf, FrameBoxes &gf)
+{
+    cv::RNG rng(seed);
+    for (int f = 0; f < frames; f++)
+    {
+        if (rng.uniform(0, 20) == 0)
+            continue; // frames without any box on either side
+        int n = rng.uniform(5, 23);
+        for (int k = 0; k < n; k++)
+        {
+            double x = rng.uniform(0.0, 1900.0), y = rng.uniform(0.0, 1000.0), w = rng.uniform(10.0, 60.0), h = rng.uniform(20.0, 120.0);
+            if (rng.uniform(0, 10))
+                gm[f].push_back(EvalBox{x, y, x + w, y + h});
+            if (rng.uniform(0, 10))
+                pm[f].push_back(EvalBox{std::round(x + rng.gaussian(4)), std::round(y + rng.gaussian(4)),
+                                        std::round(x + w + rng.gaussian(4)), std::round(y + h + rng.gaussian(4))});
+        }
+    }
+    auto flatten = [](const std::map<int, std::vector<EvalBox>> &m, FrameBoxes &out)
+    {
+        out = FrameBoxes();
+        out.firstFrame = m.empty() ? 0 : m.begin()->first;
+        int last = m.empty() ? 0 : m.rbegin()->first + 1;
+        out.start.assign(last - out.firstFrame + 1, 0);
+        for (int f = out.firstFrame; f < last; f++)
+        {
+            auto it = m.find(f);
+            if (it != m.end())
+                out.boxes.insert(out.boxes.end(), it->second.begin(), it->second.end());
+            out.start[f - out.firstFrame + 1] = (uint32_t)out.boxes.size();
+        }
+    };
+    flatten(pm, pf);
+    flatten(gm, gf);
+}
+
+static bool benchEvaluation(int reps)
+{
+    std::cout << "evaluation: map-based legacy vs flat parallel engine, 20000 frames (median ms)\n";
+    std::map<int, std::vector<EvalBox>> pm, gm;
+    FrameBoxes pf, gf;
+    makeEvalSet(20000, 23, pm, gm, pf, gf);
+    const int r = std::max(1, reps / 10);
+    bool ok = true;
+    const double thrs[] = {0.3, 0.5, 0.7};
+    for (double thr : thrs)
+    {
+        EvalCounts a = legacyEvaluate(pm, gm, thr), b1 = evaluate(pf, gf, std::vector<double>(1, thr), 1),
+                   bn = evaluate(pf, gf, std::vector<double>(1, thr));
+        bool same = a.tp == b1.tp && a.fp == b1.fp && a.fn == b1.fn && std::fabs(a.iouSum - b1.iouSum) < 1e-6 &&
+                    b1.tp == bn.tp && b1.fp == bn.fp && b1.fn == bn.fn && b1.iouSum == bn.iouSum;
+        ok = ok && same;
+        std::cout << "  thr=" << std::setprecision(1) << std::fixed << thr << "  TP=" << b1.tp << " FP=" << b1.fp << " FN=" << b1.fn
+                  << "  identical=" << (same ? "yes" : "NO") << "\n";
+    }
+    std::vector<double> sweep;
+    for (int k = 1; k <= 19; k++)
+        sweep.push_back(0.05 * k);
+    double legacy = timeMs("evaluate/legacy", r, [&] { legacyEvaluate(pm, gm, 0.5); });
+    double single = timeMs("evaluate/engine/threads=1", r, [&] { evaluate(pf, gf, std::vector<double>(1, 0.5), 1); });
+    double parallel = timeMs("evaluate/engine/threads=all", r, [&] { evaluate(pf, gf, std::vector<double>(1, 0.5)); });
+    double swept = timeMs("evaluate/engine/sweep19", r, [&] { evaluate(pf, gf, sweep); });
+    std::cout << std::setprecision(3) << "  legacy " << legacy << "  engine 1 thread " << single << "  all threads " << parallel
+              << "  19-threshold sweep " << swept << "\n";
+    return ok;
+}
+
+// Parsing the synthetic prediction set written as a CSV and as a binary detection file.
+static bool benchLoading(int reps)
+{
+    std::map<int, std::vector<EvalBox>> pm, gm;
+    FrameBoxes pf, gf;
+    makeEvalSet(20000, 23, pm, gm, pf, gf);
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::string csv = (dir / "sva_bench_pred.csv").string(), bin = (dir / "sva_bench_pred.bin").string();
+    {
+        std::ofstream out(csv);
+        out << "frame,x1,y1,x2,y2\n";
+        DetectionWriter w;
+        w.open(bin, 0);
+        for (const auto &kv : pm)
+            for (const EvalBox &b : kv.second)
+            {
+                out << kv.first << "," << b.x1 << "," << b.y1 << "," << b.x2 << "," << b.y2 << "\n";
+                DetRecord r = {kv.first, (float)b.x1, (float)b.y1, (float)b.x2, (float)b.y2, -1, -1};
+                w.add(r);
+            }
+        if (!out || !w.close())
+        {
+            std::cout << "loading: could not write the synthetic files to " << dir.string() << ", skipped\n";
+            return true;
+        }
+    }
+    auto same = [&](const FrameBoxes &f)
+    {
+        if (f.firstFrame != pf.firstFrame || f.start != pf.start || f.boxes.size() != pf.boxes.size())
+            return false;
+        for (size_t i = 0; i < f.boxes.size(); i++)
+            if (f.boxes[i].x1 != pf.boxes[i].x1 || f.boxes[i].y1 != pf.boxes[i].y1 || f.boxes[i].x2 != pf.boxes[i].x2 ||
+                f.boxes[i].y2 != pf.boxes[i].y2)
+                return false;
+        return true;
+    };
+    FrameBoxes a, b;
+    const int r = std::max(1, reps / 3);
+    double csvMs = timeMs("loadFrameBoxes/csv", r, [&] { loadFrameBoxes(csv, 0, a); });
+    double binMs = timeMs("loadFrameBoxes/bin", r, [&] { loadFrameBoxes(bin, 0, b); });
+    bool ok = same(a) && same(b);
+    std::cout << "loading: " << pf.boxes.size() << " boxes over 20000 frames (median ms)\n"
+              << std::fixed << std::setprecision(3) << "  csv " << csvMs << "  bin " << binMs
+              << "  identical=" << (ok ? "yes" : "NO") << "\n";
+    std::remove(csv.c_str());
+    std::remove(bin.c_str());
+    return ok;
+}
+
+// Steady-state heap traffic of PlayerDetector::detect. OpenCV's findContours copies its input into
+// a padded image on every call, so two mask-sized blocks per frame are outside our control; the
+// check is that the detector adds nothing frame-sized on top of that and that mergeBoxes is
+// allocation-free once warm.
+static bool benchAllocations()
+{
+#ifndef HAVE_ALLOC_COUNTER
+    std::cout << "allocations: counting allocator not available on this platform, skipped\n";
+    return true;
+#else
+    const cv::Size sz(1920, 1080);
+    const int warm = 30, measured = 20;
+    std::vector<cv::Mat> frames;
+    for (int i = 0; i < warm + measured; i++)
+        frames.push_back(makePitchFrame(sz, 22, 100 + i));
+    PlayerDetector det;
+    std::vector<cv::Rect> boxes;
+    for (int i = 0; i < warm; i++)
+        det.detect(frames[i], boxes);
+
+    AllocCount a = countAllocations([&] {
+        for (int i = warm; i < warm + measured; i++)
+            det.detect(frames[i], boxes);
+    });
+    cv::Mat fieldCopy = det.fieldMask().clone(), playersCopy = det.playersMask().clone();
+    std::vector<std::vector<cv::Point>> cts;
+    cv::findContours(fieldCopy, cts, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    AllocCount floor = countAllocations([&] {
+        cv::findContours(fieldCopy, cts, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+        cv::findContours(playersCopy, cts, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    });
+    cv::Mat f0, p0;
+    AllocCount legacy = countAllocations([&] { legacyMasks(frames.back(), f0, p0); });
+
+    std::vector<cv::Rect> in, out;
+    cv::RNG rng(3);
+    for (int i = 0; i < 40; i++)
+        in.push_back(cv::Rect(rng.uniform(0, 1800), rng.uniform(0, 1000), rng.uniform(10, 60), rng.uniform(20, 120)));
+    det.mergeBoxes(in, out);
+    AllocCount merge = countAllocations([&] { det.mergeBoxes(in, out); });
+
+    const double perFrameBytes = double(a.bytes) / measured;
+    const double perFrameCalls = double(a.calls) / measured;
+    // Allowances for OpenCV internals beyond the two traces (background model, parallel_for_):
+    // a new per-frame Mat or std::vector in detect() exceeds the call allowance.
+    const double slack = double(sz.area()) / 4, callSlack = 16;
+    bool ok = perFrameBytes <= floor.bytes + slack && perFrameCalls <= floor.calls + callSlack && merge.calls == 0;
+    std::cout << "allocations (1920x1080, steady state)\n"
+              << std::fixed << std::setprecision(1)
+              << "  detect           " << perFrameCalls << " calls/frame, " << perFrameBytes / 1024.0 << " KiB/frame\n"
+              << "  findContours x2  " << floor.calls << " calls/frame, " << floor.bytes / 1024.0 << " KiB/frame (OpenCV internal)\n"
+              << "  legacy masks     " << legacy.calls << " calls/frame, " << legacy.bytes / 1024.0 << " KiB/frame\n"
+              << "  mergeBoxes       " << merge.calls << " calls\n"
+              << "  " << (ok ? "ok" : "FAIL: detector allocates beyond OpenCV internals") << "\n";
+    return ok;
+#endif
+}
+
+static std::string jsonEscape(const std::string &v)
+{
+    std::string out;
+    for (char c : v)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+// One benchmark per line, so --compare can read the file back without a JSON library.
+static bool writeJson(const std::string &path, int reps, bool checksOk)
+{
+    std::ofstream out(path);
+    out << "{\n  \"context\": {\"library\": \"sport-video-analysis bench\", \"opencv_version\": \"" << CV_VERSION
+        << "\", \"num_cpus\": " << cv::getNumberOfCPUs() << ", \"opencv_threads\": " << cv::getNumThreads()
+        << ", \"reps\": " << reps << ", \"checks_passed\": " << (checksOk ? "true" : "false") << "},\n  \"benchmarks\": [\n";
+    out << std::setprecision(6) << std::fixed;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult &r = results[i];
+        out << "    {\"name\": \"" << jsonEscape(r.name) << "\", \"iterations\": " << r.reps << ", \"items_per_iteration\": " << r.items
+            << ", \"real_time\": " << r.medianMs << ", \"mean_time\": " << r.meanMs << ", \"min_time\": " << r.minMs
+            << ", \"max_time\": " << r.maxMs << ", \"time_unit\": \"ms\"}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return (bool)out;
+}
+
+// name -> real_time of a file written by writeJson.
+static bool readJson(const std::string &path, std::map<std::string, double> &times)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    std::string line;
+    const std::string nameKey = "\"name\": \"", timeKey = "\"real_time\": ";
+    while (std::getline(in, line))
+    {
+        size_t n = line.find(nameKey), t = line.find(timeKey);
+        if (n == std::string::npos || t == std::string::npos)
+            continue;
+        n += nameKey.size();
+        size_t e = line.find('"', n);
+        if (e == std::string::npos)
+            continue;
+        times[line.substr(n, e - n)] = std::atof(line.c_str() + t + timeKey.size());
+    }
+    return true;
+}
+
+// Median change per benchmark present in both runs; false when any got slower than maxSlowdown
+// percent (a negative limit only reports).
+static bool compareWith(const std::string &path, double maxSlowdown)
+{
+    std::map<std::string, double> base;
+    if (!readJson(path, base))
+    {
+        std::cerr << "Error: could not read " << path << "\n";
+        return false;
+    }
+    bool ok = true;
+    int compared = 0;
+    std::cout << "compare with " << path << " (median ms)\n";
+    for (const BenchResult &r : results)
+    {
+        auto it = base.find(r.name);
+        if (it == base.end() || it->second <= 0)
+            continue;
+        double change = 100.0 * (r.medianMs - it->second) / it->second;
+        bool slow = maxSlowdown >= 0 && change > maxSlowdown;
+        ok = ok && !slow;
+        compared++;
+        std::cout << "  " << std::left << std::setw(40) << r.name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << it->second << " -> " << std::setw(10) << r.medianMs << std::showpos << std::setprecision(1)
+                  << std::setw(9) << change << "%" << std::noshowpos << (slow ? "  SLOWER" : "") << "\n";
+    }
+    std::cout << "  " << compared << " of " << results.size() << " benchmarks found in the baseline\n";
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int reps = 30;
+    std::string only, jsonPath, comparePath;
+    double maxSlowdown = -1;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string a = argv[i];
+        if (a == "--only" && i + 1 < argc)
+            only = "," + std::string(argv[++i]) + ",";
+        else if (a == "--json" && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (a == "--compare" && i + 1 < argc)
+            comparePath = argv[++i];
+        else if (a == "--max-slowdown" && i + 1 < argc)
+            maxSlowdown = std::atof(argv[++i]);
+        else if (a == "--reps" && i + 1 < argc)
+            reps = std::max(1, std::atoi(argv[++i]));
+        else if (!a.empty() && std::isdigit((unsigned char)a[0]))
+            reps = std::max(1, std::atoi(a.c_str()));
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [reps=30] [--only section,...] [--json results.json] [--compare baseline.json [--max-slowdown pct]]\n"
+                      << "  sections: masks kernels incremental bands background merge features heatmap evaluation loading allocations\n";
+            return 2;
+        }
+    }
+    auto run = [&](const char *section) { return only.empty() || only.find("," + std::string(section) + ",") != std::string::npos; };
+    bool ok = true;
+    if (run("masks"))
+        ok = benchMasks(reps) && ok;
+    if (run("kernels"))
+        ok = benchKernels(reps) && ok;
+    if (run("incremental"))
+        ok = benchIncremental() && ok;
+    if (run("bands"))
+        ok = benchBands(reps) && ok;
+    if (run("background"))
+        ok = benchBackground(reps) && ok;
+    if (run("merge"))
+        ok = benchMergeBoxes(reps) && ok;
+    if (run("features"))
+        ok = benchFeatures(reps) && ok;
+    if (run("heatmap"))
+        ok = benchHeatmap(reps) && ok;
+    if (run("evaluation"))
+        ok = benchEvaluation(reps) && ok;
+    if (run("loading"))
+        ok = benchLoading(reps) && ok;
+    if (run("allocations"))
+        ok = benchAllocations() && ok;
+    if (!ok)
+        std::cerr << "One or more checks failed\n";
+    if (!jsonPath.empty() && !writeJson(jsonPath, reps, ok))
+    {
+        std::cerr << "Error: could not write " << jsonPath << "\n";
+        return 1;
+    }
+    if (!comparePath.empty() && !compareWith(comparePath, maxSlowdown))
+    {
+        std::cerr << "Slower than the baseline beyond --max-slowdown, or the baseline could not be read\n";
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
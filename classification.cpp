@@ -7,91 +7,165 @@
          No external source code beyond standard libraries and OpenCV.
 ********************************************************************************/
 #include "classification.h"
-#include <map>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include "profiler.h"
 
-static std::vector<cv::Mat> teamFeatureAnchors;
-static int anchorCount=0;
 static const int MAX_ANCHOR_FRAMES=10;
-static bool teamAnchorsInitialized=false;
-static std::map<int,std::pair<cv::Rect,int> > lastFrameBoxes;
-static int nextID=0;
 static const int teamsCount=2;
+static const int REFRESH_INTERVAL=250;      // frames between forced re-clusters once anchors are settled
+static const double DRIFT_RATIO=1.5;        // re-cluster when the mean anchor distance grows past this ratio...
+static const double DRIFT_MIN_LAB=12.0;     // ...of its value at the last re-cluster, but never below this (Lab units)
+static const int FEATURE_MAX_AGE=15;        // frames a track's cached jersey feature stays valid
 
-static cv::Vec3f avgNonGreenLab(const cv::Mat &roi){
-    cv::Mat hsv; cv::cvtColor(roi,hsv,cv::COLOR_BGR2HSV);
-    cv::Mat g; cv::inRange(hsv,cv::Scalar(35,40,40),cv::Scalar(90,255,255),g);
-    cv::Mat lab; cv::cvtColor(roi,lab,cv::COLOR_BGR2Lab); lab.convertTo(lab,CV_32F);
-    cv::Mat r=lab.reshape(1,lab.rows*lab.cols);
-    std::vector<cv::Vec3f> v; v.reserve(r.rows);
-    for(int i=0;i<r.rows;i++) if(g.at<uchar>(i)==0) v.push_back(r.at<cv::Vec3f>(i));
-    if(v.empty()) return cv::Vec3f(0,0,0);
-    std::sort(v.begin(),v.end(),[](const cv::Vec3f &a,const cv::Vec3f &b){return cv::norm(a)>cv::norm(b);});
-    int n=(int)std::min<size_t>(v.size(),500);
-    cv::Vec3f s(0,0,0); for(int i=0;i<n;i++) s+=v[i];
+static const int ROI_W=32, ROI_H=64, TOP_K=500;
+
+// Lab values are 8-bit integers, so ranking by the integer squared norm gives the same order as
+// cv::norm and the sum is exact whatever order it is taken in; key packs (normSq<<11 | pixel) into one word.
+cv::Vec3f avgNonGreenLab(const cv::Mat &lab,const cv::Mat &green,std::vector<uint32_t> &keys){
+    keys.clear();
+    const uchar *l=lab.ptr<uchar>(0), *g=green.ptr<uchar>(0);
+    for(int i=0;i<ROI_W*ROI_H;i++,l+=3){
+        if(g[i]) continue;
+        uint32_t n2=(uint32_t)l[0]*l[0]+(uint32_t)l[1]*l[1]+(uint32_t)l[2]*l[2];
+        keys.push_back((n2<<11)|(uint32_t)i);
+    }
+    if(keys.empty()) return cv::Vec3f(0,0,0);
+    int n=(int)std::min<size_t>(keys.size(),TOP_K);
+    if((int)keys.size()>n) std::nth_element(keys.begin(),keys.begin()+(n-1),keys.end(),std::greater<uint32_t>());
+    const uchar *base=lab.ptr<uchar>(0); cv::Vec3f s(0,0,0);
+    for(int k=0;k<n;k++){ const uchar *p=base+3*(keys[k]&2047u); s+=cv::Vec3f(p[0],p[1],p[2]); }
     return s*(1.0f/n);
 }
 
-static int findClosestBox(const cv::Rect &cur,const std::map<int,std::pair<cv::Rect,int> > &last){
-    int best=-1; double dmin=50.0;
-    for(std::map<int,std::pair<cv::Rect,int> >::const_iterator it=last.begin();it!=last.end();++it){
-        cv::Rect p=it->second.first;
-        cv::Point2f c1=(cur.tl()+cur.br())*0.5f, c2=(p.tl()+p.br())*0.5f;
-        double d=cv::norm(c1-c2);
-        if(d<dmin){ dmin=d; best=it->first; }
+void TeamClassifier::extractFeatures(const cv::Mat &frame,const std::vector<cv::Rect> &boxes,std::vector<cv::Vec3f> &out){
+    const int n=(int)boxes.size();
+    out.assign(n,cv::Vec3f(0,0,0));
+    if(n==0) return;
+    // All ROIs are resized straight into one tall strip of 32x64 tiles so the colour conversions
+    // run once per frame; the strip only grows, and shorter frames use a row range of it.
+    if(tiles.rows<n*ROI_H){
+        int cap=std::max(n,32)*ROI_H;
+        tiles.create(cap,ROI_W,CV_8UC3); tilesHsv.create(cap,ROI_W,CV_8UC3); tilesLab.create(cap,ROI_W,CV_8UC3); tilesGreen.create(cap,ROI_W,CV_8UC1);
+    }
+    valid.assign(n,0);
+    for(int i=0;i<n;i++){
+        cv::Rect sb=boxes[i]&cv::Rect(0,0,frame.cols,frame.rows);
+        if(sb.area()<=0) continue;
+        cv::Mat dst=tiles.rowRange(i*ROI_H,(i+1)*ROI_H);
+        cv::resize(frame(sb),dst,cv::Size(ROI_W,ROI_H));
+        valid[i]=1;
+    }
+    cv::Mat bgr=tiles.rowRange(0,n*ROI_H), hsv=tilesHsv.rowRange(0,n*ROI_H), lab=tilesLab.rowRange(0,n*ROI_H), green=tilesGreen.rowRange(0,n*ROI_H);
+    cv::cvtColor(bgr,hsv,cv::COLOR_BGR2HSV);
+    cv::inRange(hsv,cv::Scalar(35,40,40),cv::Scalar(90,255,255),green);
+    cv::cvtColor(bgr,lab,cv::COLOR_BGR2Lab);
+    for(int i=0;i<n;i++){
+        if(!valid[i]) continue;
+        out[i]=avgNonGreenLab(lab.rowRange(i*ROI_H,(i+1)*ROI_H),green.rowRange(i*ROI_H,(i+1)*ROI_H),normKeys);
     }
-    return best;
 }
 
-std::vector<std::pair<cv::Rect,int> > classifyPlayers(const cv::Mat &frame,const std::vector<cv::Rect> &boxes){
-    std::vector<cv::Vec3f> feats; feats.reserve(boxes.size());
-    for(size_t i=0;i<boxes.size();i++){
-        cv::Rect sb=boxes[i]&cv::Rect(0,0,frame.cols,frame.rows);
-        if(sb.area()<=0){ feats.push_back(cv::Vec3f(0,0,0)); continue; }
-        cv::Mat roi=frame(sb); cv::resize(roi,roi,cv::Size(32,64));
-        feats.push_back(avgNonGreenLab(roi));
+TeamClassifier::TeamClassifier():anchorCount(0),teamAnchorsInitialized(false),framesSinceRecluster(0),settledDist(0){}
+
+// Nearest anchor for every feature; returns the mean feature-to-anchor distance.
+static double assignToAnchors(const std::vector<cv::Vec3f> &feats,const std::vector<cv::Mat> &anchors,std::vector<int> &team){
+    team.resize(feats.size()); double sum=0;
+    for(size_t i=0;i<feats.size();i++){
+        float best=FLT_MAX; int bt=0;
+        for(int t=0;t<(int)anchors.size();t++){
+            const float *a=anchors[t].ptr<float>(0);
+            float d0=feats[i][0]-a[0], d1=feats[i][1]-a[1], d2=feats[i][2]-a[2], d=d0*d0+d1*d1+d2*d2;
+            if(d<best){ best=d; bt=t; }
+        }
+        team[i]=bt; sum+=std::sqrt(best);
     }
-    if(feats.empty()) return std::vector<std::pair<cv::Rect,int> >();
-    cv::Mat X((int)feats.size(),3,CV_32F);
-    for(int i=0;i<X.rows;i++){ X.at<float>(i,0)=feats[i][0]; X.at<float>(i,1)=feats[i][1]; X.at<float>(i,2)=feats[i][2]; }
-    if(X.rows<teamsCount) return std::vector<std::pair<cv::Rect,int> >();
-    cv::Mat labels,centers;
-    cv::kmeans(X,teamsCount,labels,cv::TermCriteria(cv::TermCriteria::EPS+cv::TermCriteria::COUNT,10,1.0),5,cv::KMEANS_PP_CENTERS,centers);
-    if(anchorCount<MAX_ANCHOR_FRAMES){
-        if(teamFeatureAnchors.empty()){ for(int i=0;i<centers.rows;i++) teamFeatureAnchors.push_back(centers.row(i).clone()); }
-        else{
-            for(int i=0;i<centers.rows;i++){
-                if(teamFeatureAnchors[i].size()!=centers.row(i).size()||teamFeatureAnchors[i].type()!=centers.row(i).type())
-                    teamFeatureAnchors[i]=centers.row(i).clone();
-                else
-                    teamFeatureAnchors[i]=teamFeatureAnchors[i]*0.9f+centers.row(i)*0.1f;
+    return feats.empty()?0.0:sum/feats.size();
+}
+
+// A cached jersey feature is reused until it is FEATURE_MAX_AGE frames old or the box has grown
+// or shrunk enough that the 32x64 resample would look different (always, when reuse is set).
+static bool featureStale(const Track &t,const cv::Rect &box,bool reuse){
+    if(!t.hasFeature) return true;
+    if(reuse) return false;
+    if(t.featureAge>=FEATURE_MAX_AGE) return true;
+    double ratio=(double)box.area()/std::max(1,t.featureSize.area());
+    return ratio<0.7||ratio>1.4;
+}
+
+std::vector<ClassifiedPlayer> TeamClassifier::classify(const cv::Mat &frame,const std::vector<cv::Rect> &boxes){
+    { PROFILE_SCOPE("classify.tracking"); tracker.update(boxes,trackOf); }
+    std::vector<Track> &tracks=tracker.tracks();
+    staleIdx.clear(); staleBoxes.clear();
+    for(size_t i=0;i<boxes.size();i++) if(featureStale(tracks[trackOf[i]],boxes[i],reuseFeatures)){ staleIdx.push_back((int)i); staleBoxes.push_back(boxes[i]); }
+    { PROFILE_SCOPE("classify.features"); extractFeatures(frame,staleBoxes,fresh); }
+    for(size_t k=0;k<staleIdx.size();k++){
+        Track &t=tracks[trackOf[staleIdx[k]]];
+        t.feature=fresh[k]; t.featureSize=staleBoxes[k].size(); t.featureAge=0; t.hasFeature=true;
+    }
+    modelStats.featuresExtracted+=(long)staleIdx.size(); modelStats.featuresCached+=(long)(boxes.size()-staleIdx.size());
+    feats.resize(boxes.size());
+    for(size_t i=0;i<boxes.size();i++) feats[i]=tracks[trackOf[i]].feature;
+    if(feats.empty()) return std::vector<ClassifiedPlayer>();
+    if((int)feats.size()<teamsCount&&!teamAnchorsInitialized) return std::vector<ClassifiedPlayer>();
+    // Once the anchors have settled, nearest-anchor assignment replaces k-means. k-means runs
+    // again when players drift away from the anchors or the refresh interval elapses.
+    bool recluster=!teamAnchorsInitialized;
+    if(!recluster){
+        PROFILE_SCOPE("classify.anchors");
+        double meanDist=assignToAnchors(feats,teamFeatureAnchors,teams);
+        if((int)feats.size()>=teamsCount&&++framesSinceRecluster>=REFRESH_INTERVAL){ recluster=true; modelStats.refreshReclusters++; }
+        else if((int)feats.size()>=teamsCount&&meanDist>std::max(DRIFT_MIN_LAB,DRIFT_RATIO*settledDist)){ recluster=true; modelStats.driftReclusters++; }
+        else modelStats.anchorFrames++;
+    }
+    if(recluster){
+        PROFILE_SCOPE("classify.kmeans");
+        cv::Mat X((int)feats.size(),3,CV_32F);
+        for(int i=0;i<X.rows;i++){ X.at<float>(i,0)=feats[i][0]; X.at<float>(i,1)=feats[i][1]; X.at<float>(i,2)=feats[i][2]; }
+        cv::Mat labels,centers;
+        cv::kmeans(X,teamsCount,labels,cv::TermCriteria(cv::TermCriteria::EPS+cv::TermCriteria::COUNT,10,1.0),5,cv::KMEANS_PP_CENTERS,centers);
+        modelStats.kmeansFrames++;
+        bool warmup=anchorCount<MAX_ANCHOR_FRAMES;
+        if(warmup){
+            if(teamFeatureAnchors.empty()){ for(int i=0;i<centers.rows;i++) teamFeatureAnchors.push_back(centers.row(i).clone()); }
+            else{
+                for(int i=0;i<centers.rows;i++){
+                    if(teamFeatureAnchors[i].size()!=centers.row(i).size()||teamFeatureAnchors[i].type()!=centers.row(i).type())
+                        teamFeatureAnchors[i]=centers.row(i).clone();
+                    else
+                        teamFeatureAnchors[i]=teamFeatureAnchors[i]*0.9f+centers.row(i)*0.1f;
+                }
             }
+            anchorCount++; if(anchorCount==MAX_ANCHOR_FRAMES) teamAnchorsInitialized=true;
         }
-        anchorCount++; if(anchorCount==MAX_ANCHOR_FRAMES) teamAnchorsInitialized=true;
-    }
-    std::vector<int> mapLab(teamsCount,-1); std::vector<bool> used(teamsCount,false);
-    for(int fixed=0;fixed<teamsCount;fixed++){
-        float md=FLT_MAX; int bj=-1;
-        for(int i=0;i<teamsCount;i++){
-            if(used[i]) continue;
-            float d=cv::norm(teamFeatureAnchors[fixed]-centers.row(i));
-            if(d<md){ md=d; bj=i; }
+        std::vector<int> mapLab(teamsCount,-1); std::vector<bool> used(teamsCount,false);
+        for(int fixed=0;fixed<teamsCount;fixed++){
+            float md=FLT_MAX; int bj=-1;
+            for(int i=0;i<teamsCount;i++){
+                if(used[i]) continue;
+                float d=cv::norm(teamFeatureAnchors[fixed]-centers.row(i));
+                if(d<md){ md=d; bj=i; }
+            }
+            if(bj!=-1){ mapLab[bj]=fixed; used[bj]=true; }
+        }
+        // After warm-up a re-cluster nudges the anchors towards the matching new centres.
+        if(!warmup) for(int i=0;i<teamsCount;i++) if(mapLab[i]>=0) teamFeatureAnchors[mapLab[i]]=teamFeatureAnchors[mapLab[i]]*0.9f+centers.row(i)*0.1f;
+        teams.resize(feats.size());
+        for(size_t i=0;i<feats.size();i++) teams[i]=mapLab[labels.at<int>((int)i)];
+        if(teamAnchorsInitialized){
+            std::vector<int> tmp; settledDist=assignToAnchors(feats,teamFeatureAnchors,tmp);
+            framesSinceRecluster=0;
         }
-        if(bj!=-1){ mapLab[bj]=fixed; used[bj]=true; }
     }
-    std::vector<std::pair<cv::Rect,int> > out; out.reserve(boxes.size());
-    std::map<int,std::pair<cv::Rect,int> > now;
+    // A track keeps the team it was first given, as the old nearest-box matching did.
+    std::vector<ClassifiedPlayer> out; out.reserve(boxes.size());
     for(size_t i=0;i<boxes.size();i++){
-        int raw=labels.at<int>((int)i);
-        int team=mapLab[raw];
-        int mid=findClosestBox(boxes[i],lastFrameBoxes);
-        if(mid!=-1){
-            if(lastFrameBoxes.at(mid).second!=team) team=lastFrameBoxes.at(mid).second;
-            now[mid]=std::make_pair(boxes[i],team);
-        }else{
-            now[nextID++]=std::make_pair(boxes[i],team);
-        }
-        out.push_back(std::make_pair(boxes[i],team));
+        Track &t=tracks[trackOf[i]];
+        if(t.team<0) t.team=teams[i];
+        ClassifiedPlayer p; p.box=boxes[i]; p.team=t.team; p.trackId=t.id;
+        out.push_back(p);
     }
-    lastFrameBoxes=now;
     return out;
 }
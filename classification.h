@@ -9,6 +9,37 @@
 #ifndef CLASSIFICATION_H
 #define CLASSIFICATION_H
 #include <opencv2/opencv.hpp>
+#include <cstdint>
 #include <vector>
-std::vector<std::pair<cv::Rect,int> > classifyPlayers(const cv::Mat &frame,const std::vector<cv::Rect> &boxes);
+#include "tracking.h"
+
+struct ClassifiedPlayer{ cv::Rect box; int team; int trackId; };
+// How often the team model ran k-means versus the O(n) nearest-anchor assignment.
+// featuresExtracted/featuresCached count boxes whose jersey feature was recomputed or reused.
+struct TeamModelStats{ long kmeansFrames=0,anchorFrames=0,driftReclusters=0,refreshReclusters=0,featuresExtracted=0,featuresCached=0; };
+
+// Jersey feature of one 32x64 tile (8-bit Lab pixels and their green mask, both continuous): mean
+// of the 500 largest-norm non-green pixels. keys is scratch space kept by the caller.
+cv::Vec3f avgNonGreenLab(const cv::Mat &lab,const cv::Mat &green,std::vector<uint32_t> &keys);
+
+// Per-stream team classifier: jersey-colour anchors and the player tracker live here, so several
+// streams can be classified in one process.
+class TeamClassifier{
+    std::vector<cv::Mat> teamFeatureAnchors; int anchorCount; bool teamAnchorsInitialized;
+    PlayerTracker tracker; std::vector<int> trackOf,staleIdx; std::vector<cv::Rect> staleBoxes; std::vector<cv::Vec3f> fresh;
+    cv::Mat tiles,tilesHsv,tilesLab,tilesGreen; std::vector<char> valid; std::vector<uint32_t> normKeys; std::vector<cv::Vec3f> feats;
+    std::vector<int> teams; int framesSinceRecluster; double settledDist; bool reuseFeatures=false; TeamModelStats modelStats;
+public:
+    TeamClassifier();
+    // Jersey colour descriptor of every box: mean of the brightest non-green Lab pixels of the
+    // ROI resized to 32x64. All boxes of a frame are converted together in reusable buffers.
+    void extractFeatures(const cv::Mat &frame,const std::vector<cv::Rect> &boxes,std::vector<cv::Vec3f> &out);
+    // Tracks the boxes, refreshes stale per-track features and assigns teams (0/1) and track IDs.
+    std::vector<ClassifiedPlayer> classify(const cv::Mat &frame,const std::vector<cv::Rect> &boxes);
+    // Live mode: frames dropped since the last classify() (tracks coast over them), and whether a
+    // tracked player's cached feature is kept however old it is (only new tracks are extracted).
+    void skipFrames(int n){ tracker.coast(n); }
+    void setReuseFeatures(bool on){ reuseFeatures=on; }
+    const TeamModelStats &stats() const { return modelStats; }
+};
 #endif
@@ -0,0 +1,65 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+// det_to_csv.cpp
+// Usage: ./det_to_csv <detections.bin> [out.csv=-]
+// Exports a binary detection file (detfile.h) as the CSV the other tools read: frame,x1,y1,x2,y2
+// plus team and track_id when the file carries them. Writes to stdout when no output is given.
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include "detfile.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <detections.bin> [out.csv=-]\n";
+        return 1;
+    }
+    DetectionReader reader;
+    std::string err;
+    if (!reader.open(argv[1], &err))
+    {
+        std::cerr << "Load error: " << err << "\n";
+        return 2;
+    }
+    const std::string out_path = (argc >= 3) ? argv[2] : "-";
+    std::FILE *out = out_path == "-" ? stdout : std::fopen(out_path.c_str(), "w");
+    if (!out)
+    {
+        std::cerr << "Cannot write " << out_path << "\n";
+        return 1;
+    }
+
+    const bool team = reader.flags() & DET_HAS_TEAM, track = reader.flags() & DET_HAS_TRACK;
+    std::fputs("frame,x1,y1,x2,y2", out);
+    std::fputs(team ? ",team" : "", out);
+    std::fputs(track ? ",track_id" : "", out);
+    std::fputc('\n', out);
+    // %.6g matches the default iostream formatting the CSV writers use.
+    for (size_t i = 0; i < reader.size(); ++i)
+    {
+        const DetRecord &r = reader.records()[i];
+        std::fprintf(out, "%d,%.6g,%.6g,%.6g,%.6g", r.frame, r.x1, r.y1, r.x2, r.y2);
+        if (team)
+            std::fprintf(out, ",%d", r.team);
+        if (track)
+            std::fprintf(out, ",%d", r.trackId);
+        std::fputc('\n', out);
+    }
+    const bool ok = !std::ferror(out);
+    if (out != stdout)
+        std::fclose(out);
+    if (!ok)
+    {
+        std::cerr << "Error writing " << out_path << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -7,87 +7,583 @@
          No external source code beyond standard libraries and OpenCV.
 ********************************************************************************/
 #include "detection.h"
+#include "background.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include "profiler.h"
 
-static cv::Mat maskGreenField(const cv::Mat &hsv){
-    cv::Mat mask,dilated,eroded,out;
-    cv::inRange(hsv,cv::Scalar(40,40,40),cv::Scalar(90,255,255),mask);
-    cv::Mat k=cv::getStructuringElement(cv::MORPH_RECT,cv::Size(5,5));
-    cv::dilate(mask,dilated,k);
-    cv::erode(dilated,eroded,k);
-    cv::erode(eroded,eroded,k);
-    cv::erode(eroded,eroded,k);
-    cv::erode(eroded,eroded,k);
-    std::vector<std::vector<cv::Point> > cts;
-    cv::findContours(eroded,cts,cv::RETR_EXTERNAL,cv::CHAIN_APPROX_SIMPLE);
-    out=cv::Mat::zeros(mask.size(),CV_8UC1);
-    for(size_t i=0;i<cts.size();i++){
-        if(cv::contourArea(cts[i])>1000.0) cv::drawContours(out,cts,(int)i,cv::Scalar(255),cv::FILLED);
-    }
-    cv::imshow("Green Field Mask",out);
-    return out;
-}
-
-static cv::Mat maskGreenPlayers(const cv::Mat &hsvFieldMaskedBgr){
-    cv::Mat hsv; cv::cvtColor(hsvFieldMaskedBgr,hsv,cv::COLOR_BGR2HSV);
-    cv::Mat greenMask,blackMask,mask;
-    cv::inRange(hsv,cv::Scalar(40,40,40),cv::Scalar(90,255,255),greenMask);
-    cv::inRange(hsv,cv::Scalar(0,0,0),cv::Scalar(10,10,10),blackMask);
-    cv::bitwise_or(greenMask,blackMask,mask);
-    cv::bitwise_not(mask,mask);
-    int d=5;
-    cv::Mat elem=cv::getStructuringElement(cv::MORPH_RECT,cv::Size(2*d+1,2*d+1),cv::Point(d,d));
-    cv::dilate(mask,mask,elem);
-    cv::Mat result;
-    hsvFieldMaskedBgr.copyTo(result,mask);
+// Single pass over the HSV frame producing both colour masks (bounds from DetectorConfig):
+//   green     = H 40..90, S,V >= 40                      (pitch candidate)
+//   playerRaw = not green and not near-black (H,S,V <= 10) (jersey candidate)
+// Inside the pitch this equals the old masked-BGR -> HSV round trip, outside the pitch the old
+// path saw black pixels, which maskGreenPlayers reproduces by AND-ing with the field mask.
+class GreenMaskBody: public cv::ParallelLoopBody{
+    const cv::Mat &hsv; cv::Mat &green,&playerRaw; int h0,h1,s0,s1,v0,v1,blk;
+public:
+    GreenMaskBody(const cv::Mat &h,cv::Mat &g,cv::Mat &p,const DetectorConfig &c):hsv(h),green(g),playerRaw(p),
+        h0(c.greenHMin),h1(c.greenHMax),s0(c.greenSMin),s1(c.greenSMax),v0(c.greenVMin),v1(c.greenVMax),blk(c.blackMax){}
+    void operator()(const cv::Range &r) const override{
+        for(int y=r.start;y<r.end;y++){
+            const uchar *p=hsv.ptr<uchar>(y); uchar *g=green.ptr<uchar>(y); uchar *q=playerRaw.ptr<uchar>(y);
+            for(int x=0;x<hsv.cols;x++,p+=3){
+                uchar isGreen=(uchar)((p[0]>=h0)&(p[0]<=h1)&(p[1]>=s0)&(p[1]<=s1)&(p[2]>=v0)&(p[2]<=v1));
+                uchar isBlack=(uchar)((p[0]<=blk)&(p[1]<=blk)&(p[2]<=blk));
+                g[x]=(uchar)(0-isGreen); q[x]=(uchar)((isGreen|isBlack)-1);
+            }
+        }
+    }
+};
+
+// Name table shared by the config file reader/writer and the sweep tool.
+struct DetectorParam{ const char *key; double DetectorConfig::*d; int DetectorConfig::*i; bool DetectorConfig::*b; };
+static const DetectorParam PARAMS[]={
+    {"scale",&DetectorConfig::scale,nullptr,nullptr},{"refine",nullptr,nullptr,&DetectorConfig::refine},
+    {"background",nullptr,&DetectorConfig::background,nullptr},{"bg_threshold",&DetectorConfig::bgThreshold,nullptr,nullptr},
+    {"mog_history",nullptr,&DetectorConfig::mogHistory,nullptr},{"mog_var_threshold",&DetectorConfig::mogVarThreshold,nullptr,nullptr},
+    {"learning_rate",&DetectorConfig::learningRate,nullptr,nullptr},
+    {"green_h_min",nullptr,&DetectorConfig::greenHMin,nullptr},{"green_h_max",nullptr,&DetectorConfig::greenHMax,nullptr},
+    {"green_s_min",nullptr,&DetectorConfig::greenSMin,nullptr},{"green_s_max",nullptr,&DetectorConfig::greenSMax,nullptr},
+    {"green_v_min",nullptr,&DetectorConfig::greenVMin,nullptr},{"green_v_max",nullptr,&DetectorConfig::greenVMax,nullptr},
+    {"black_max",nullptr,&DetectorConfig::blackMax,nullptr},{"field_min_area",&DetectorConfig::fieldMinArea,nullptr,nullptr},
+    {"min_area",&DetectorConfig::minArea,nullptr,nullptr},
+    {"min_width",nullptr,&DetectorConfig::minWidth,nullptr},{"min_height",nullptr,&DetectorConfig::minHeight,nullptr},
+    {"max_width",nullptr,&DetectorConfig::maxWidth,nullptr},{"max_height",nullptr,&DetectorConfig::maxHeight,nullptr},
+    {"dilate",nullptr,&DetectorConfig::dilate,nullptr},
+    {"field_refresh",nullptr,&DetectorConfig::fieldRefresh,nullptr},{"field_motion",&DetectorConfig::fieldMotion,nullptr,nullptr},
+    {"bands",nullptr,&DetectorConfig::bands,nullptr},
+};
+
+static const DetectorParam *findParam(const std::string &key){
+    for(const DetectorParam &p:PARAMS) if(key==p.key) return &p;
+    return nullptr;
+}
+
+const std::vector<std::string> &detectorParamNames(){
+    static const std::vector<std::string> names=[]{ std::vector<std::string> v; for(const DetectorParam &p:PARAMS) v.push_back(p.key); return v; }();
+    return names;
+}
+
+bool setDetectorParam(DetectorConfig &cfg,const std::string &key,double value){
+    const DetectorParam *p=findParam(key); if(!p) return false;
+    if(p->d) cfg.*(p->d)=value; else if(p->i) cfg.*(p->i)=cvRound(value); else cfg.*(p->b)=value!=0;
+    return true;
+}
+
+bool getDetectorParam(const DetectorConfig &cfg,const std::string &key,double &value){
+    const DetectorParam *p=findParam(key); if(!p) return false;
+    value=p->d?cfg.*(p->d):p->i?(double)(cfg.*(p->i)):(cfg.*(p->b)?1.0:0.0);
+    return true;
+}
+
+bool readDetectorConfig(const cv::FileNode &node,DetectorConfig &cfg,std::string *error){
+    if(!node.isMap()){ if(error) *error="detector config must be a map"; return false; }
+    for(cv::FileNodeIterator it=node.begin();it!=node.end();++it){
+        cv::FileNode n=*it;
+        if(n.name()=="name") continue; // label used by sweep lists
+        if(!n.isInt()&&!n.isReal()){ if(error) *error="'"+n.name()+"' is not a number"; return false; }
+        if(!setDetectorParam(cfg,n.name(),(double)n)){ if(error) *error="unknown detector parameter '"+n.name()+"'"; return false; }
+    }
+    return true;
+}
+
+bool loadDetectorConfig(const std::string &path,DetectorConfig &cfg,std::string *error){
+    cv::FileStorage fs;
+    try{ fs.open(path,cv::FileStorage::READ); }catch(const cv::Exception &e){ if(error) *error=path+": "+e.what(); return false; }
+    if(!fs.isOpened()){ if(error) *error="cannot open "+path; return false; }
+    cv::FileNode root=fs.root(), det=root["detector"];
+    if(!readDetectorConfig(det.empty()?root:det,cfg,error)){ if(error) *error=path+": "+*error; return false; }
+    return true;
+}
+
+bool saveDetectorConfig(const std::string &path,const DetectorConfig &cfg){
+    cv::FileStorage fs(path,cv::FileStorage::WRITE); if(!fs.isOpened()) return false;
+    fs<<"detector"<<"{";
+    for(const DetectorParam &p:PARAMS){
+        if(p.d) fs<<p.key<<cfg.*(p.d); else if(p.i) fs<<p.key<<cfg.*(p.i); else fs<<p.key<<(int)(cfg.*(p.b));
+    }
+    fs<<"}";
+    return true;
+}
+
+PlayerDetector::PlayerDetector(const DetectorConfig &config)
+    :PlayerDetector(createBackgroundModel(config),config){}
+
+PlayerDetector::PlayerDetector(const cv::Ptr<cv::BackgroundSubtractor> &bg,const DetectorConfig &config):bgSub(bg),cfg(config),debugWindows(false){
+    if(!(cfg.scale>0.0&&cfg.scale<=1.0)) cfg.scale=1.0;
+    buildKernels();
+}
+
+void PlayerDetector::buildKernels(){
+    // Structuring elements shrink with the processing scale (5x5 and (2*dilate+1)^2 at full resolution).
+    const int fk=std::max(3,2*cvRound(2.0*cfg.scale)+1), d=cfg.dilate>0?std::max(1,cvRound(cfg.dilate*cfg.scale)):0;
+    fieldKernel=cv::getStructuringElement(cv::MORPH_RECT,cv::Size(fk,fk));
+    playerKernel=cv::getStructuringElement(cv::MORPH_RECT,cv::Size(2*d+1,2*d+1),cv::Point(d,d));
+    const int rd=std::max(0,cfg.dilate);
+    refineKernel=cv::getStructuringElement(cv::MORPH_RECT,cv::Size(2*rd+1,2*rd+1));
+}
+
+void PlayerDetector::setScale(double scale){
+    if(!(scale>0.0&&scale<=1.0)||scale==cfg.scale) return;
+    cv::Mat bg; bgSub->getBackgroundImage(bg);
+    cfg.scale=scale; buildKernels(); fieldAge=-1;
+    if(bg.empty()||inputSize.empty()) return;
+    // A learning rate of 1 makes the model (MOG2 or ours) start over from the resized background.
+    cv::Size sz=scale<1.0?cv::Size(cvRound(inputSize.width*scale),cvRound(inputSize.height*scale)):inputSize; // as detect() resizes
+    cv::Mat seeded; cv::resize(bg,seeded,sz,0,0,cv::INTER_AREA);
+    bgSub->apply(seeded,fg,1.0);
+}
+
+void PlayerDetector::maskGreenField(){
+    cv::dilate(green,fieldTmp,fieldKernel);
+    cv::erode(fieldTmp,fieldTmp,fieldKernel,cv::Point(-1,-1),4);
+    fillField();
+}
+
+// Field = filled outlines of the large regions of the cleaned-up green mask (fieldTmp).
+void PlayerDetector::fillField(){
+    cv::findContours(fieldTmp,contours,cv::RETR_EXTERNAL,cv::CHAIN_APPROX_SIMPLE);
+    field.create(green.size(),CV_8UC1); field.setTo(cv::Scalar(0));
+    for(size_t i=0;i<contours.size();i++){
+        if(cv::contourArea(contours[i])>cfg.fieldMinArea*cfg.scale*cfg.scale) cv::drawContours(field,contours,(int)i,cv::Scalar(255),cv::FILLED);
+    }
+    if(debugWindows) cv::imshow("Green Field Mask",field);
+}
+
+void PlayerDetector::maskGreenPlayers(const cv::Mat &frame){
+    cv::bitwise_and(playerRaw,field,players);
+    cv::dilate(players,players,playerKernel);
+    if(debugWindows) showPlayers(frame);
+}
+
+void PlayerDetector::showPlayers(const cv::Mat &frame){
+    cv::Mat result,inField;
+    cv::bitwise_and(players,field,inField);
+    frame.copyTo(result,inField);
     cv::imshow("Players",result);
-    return mask;
 }
 
-static std::vector<cv::Rect> mergeBoxes(const std::vector<cv::Rect> &inputBoxes){
-    std::vector<cv::Rect> merged; std::vector<bool> used(inputBoxes.size(),false);
-    for(size_t i=0;i<inputBoxes.size();i++){
+void PlayerDetector::computeMasks(const cv::Mat &frame){
+    {
+        PROFILE_SCOPE("detect.field_mask");
+        cv::cvtColor(frame,hsv,cv::COLOR_BGR2HSV);
+        green.create(hsv.size(),CV_8UC1); playerRaw.create(hsv.size(),CV_8UC1);
+        cv::parallel_for_(cv::Range(0,hsv.rows),GreenMaskBody(hsv,green,playerRaw,cfg));
+        maskGreenField();
+    }
+    PROFILE_SCOPE("detect.player_mask");
+    maskGreenPlayers(frame);
+}
+
+static const int ROI_TILE=64;      // incremental mode tile side, at detection scale
+static const int MOTION_ROW_STEP=4; // camera motion is measured on every 4th row
+
+// Fraction of the sampled pixels whose pitch-colour label differs between two masks.
+static double maskChange(const cv::Mat &a,const cv::Mat &b){
+    long diff=0,total=0;
+    for(int y=0;y<a.rows;y+=MOTION_ROW_STEP){
+        const uchar *p=a.ptr<uchar>(y),*q=b.ptr<uchar>(y);
+        for(int x=0;x<a.cols;x++) diff+=p[x]!=q[x];
+        total+=a.cols;
+    }
+    return total?double(diff)/total:0.0;
+}
+
+// The field mask (dilate, four erodes, findContours, area filter) is only recomputed every
+// fieldRefresh frames, or earlier once the pitch colour mask has drifted by more than fieldMotion
+// from the one it was computed on. The jersey mask only matters where MOG2 found foreground, so it
+// is built on runs of foreground tiles, each padded by the dilation radius; inside those tiles it
+// equals the full-frame mask for the same field, and combined (fg AND players) is exact everywhere.
+void PlayerDetector::incrementalMasks(const cv::Mat &frame){
+    {
+        PROFILE_SCOPE("detect.field_mask");
+        cv::cvtColor(frame,hsv,cv::COLOR_BGR2HSV);
+        green.create(hsv.size(),CV_8UC1); playerRaw.create(hsv.size(),CV_8UC1);
+        cv::parallel_for_(cv::Range(0,hsv.rows),GreenMaskBody(hsv,green,playerRaw,cfg));
+        bool refresh=fieldAge<0||fieldAge>=cfg.fieldRefresh||field.size()!=green.size();
+        if(!refresh&&maskChange(green,refGreen)>cfg.fieldMotion){ refresh=true; detStats.motionRefreshes++; }
+        if(refresh){ maskGreenField(); green.copyTo(refGreen); fieldAge=0; detStats.fieldRefreshes++; }
+        fieldAge++;
+    }
+    PROFILE_SCOPE("detect.player_mask");
+    const int rows=green.rows, cols=green.cols, m=(playerKernel.cols-1)/2;
+    const int tw=(cols+ROI_TILE-1)/ROI_TILE, th=(rows+ROI_TILE-1)/ROI_TILE;
+    const cv::Rect full(0,0,cols,rows);
+    players.create(green.size(),CV_8UC1); players.setTo(cv::Scalar(0));
+    combined.create(green.size(),CV_8UC1); combined.setTo(cv::Scalar(0));
+    tileBuf.create(green.size(),CV_8UC1); tileDilBuf.create(green.size(),CV_8UC1); // padded runs are clipped to the frame
+    tileOn.resize(tw);
+    for(int ty=0;ty<th;ty++){
+        const int y0=ty*ROI_TILE, y1=std::min(rows,y0+ROI_TILE);
+        for(int tx=0;tx<tw;tx++){
+            const int x0=tx*ROI_TILE;
+            tileOn[tx]=cv::countNonZero(fg(cv::Rect(x0,y0,std::min(cols,x0+ROI_TILE)-x0,y1-y0)))>0;
+            detStats.activeTiles+=tileOn[tx];
+        }
+        for(int tx=0;tx<tw;){
+            if(!tileOn[tx]){ tx++; continue; }
+            int end=tx+1; while(end<tw&&tileOn[end]) end++;
+            const cv::Rect r(tx*ROI_TILE,y0,std::min(cols,end*ROI_TILE)-tx*ROI_TILE,y1-y0);
+            const cv::Rect e=cv::Rect(r.x-m,r.y-m,r.width+2*m,r.height+2*m)&full;
+            // Isolated border: the scratch buffers' other pixels must not leak into the dilation.
+            cv::Mat raw=tileBuf(cv::Rect(0,0,e.width,e.height)), dil=tileDilBuf(cv::Rect(0,0,e.width,e.height));
+            cv::bitwise_and(playerRaw(e),field(e),raw);
+            cv::dilate(raw,dil,playerKernel,cv::Point(-1,-1),1,cv::BORDER_CONSTANT|cv::BORDER_ISOLATED,cv::morphologyDefaultBorderValue());
+            dil(cv::Rect(r.x-e.x,r.y-e.y,r.width,r.height)).copyTo(players(r));
+            cv::bitwise_and(fg(r),players(r),combined(r));
+            tx=end;
+        }
+    }
+    detStats.tiles+=(long long)tw*th;
+    if(debugWindows) showPlayers(frame);
+}
+
+// ---- Band-parallel detection -------------------------------------------------------------------
+// Every mask step is evaluated per row band on the band's rows plus the reach of its structuring
+// elements, with isolated borders, so each band's rows equal the full-frame result. Contours are
+// traced per band; a component cut by a seam shows up as pieces touching the seam rows, which are
+// joined across seams (8-connectivity) and re-traced whole on the full mask inside their bounding
+// box. That re-trace also decides RETR_EXTERNAL nesting: a contour lying inside a hole of a
+// seam-crossing component is not an external contour of the frame.
+static const int ISOLATED_BORDER=cv::BORDER_CONSTANT|cv::BORDER_ISOLATED;
+
+static cv::Range bandRows(int i,int n,int rows){ return cv::Range((int)((long)i*rows/n),(int)((long)(i+1)*rows/n)); }
+static cv::Range padRows(const cv::Range &r,int pad,int rows){ return cv::Range(std::max(0,r.start-pad),std::min(rows,r.end+pad)); }
+
+// Topmost, then leftmost, pixel of a contour (as y<<32|x), which is where tracing starts.
+static uint64_t startKey(const std::vector<cv::Point> &c){
+    uint64_t k=UINT64_MAX;
+    for(size_t i=0;i<c.size();i++) k=std::min(k,((uint64_t)(uint32_t)c[i].y<<32)|(uint32_t)c[i].x);
+    return k;
+}
+
+static int findRoot(std::vector<int> &parent,int i){
+    while(parent[i]!=i){ parent[i]=parent[parent[i]]; i=parent[i]; }
+    return i;
+}
+
+void PlayerDetector::bandMasks(const cv::Mat &frame,int n){
+    const int rows=frame.rows, fieldReach=5*(fieldKernel.rows/2), playerReach=playerKernel.rows/2;
+    hsv.create(frame.size(),CV_8UC3); green.create(frame.size(),CV_8UC1); playerRaw.create(frame.size(),CV_8UC1);
+    fieldTmp.create(frame.size(),CV_8UC1); players.create(frame.size(),CV_8UC1); combined.create(frame.size(),CV_8UC1);
+    bandA.resize(n); bandB.resize(n);
+    {
+        PROFILE_SCOPE("detect.field_mask");
+        cv::parallel_for_(cv::Range(0,n),[&](const cv::Range &r){
+            for(int i=r.start;i<r.end;i++){
+                const cv::Range b=bandRows(i,n,rows); cv::Mat hb=hsv.rowRange(b);
+                cv::cvtColor(frame.rowRange(b),hb,cv::COLOR_BGR2HSV);
+                GreenMaskBody(hsv,green,playerRaw,cfg)(b);
+            }
+        });
+        // One dilate and four erodes: the band needs fieldReach rows of green on either side.
+        cv::parallel_for_(cv::Range(0,n),[&](const cv::Range &r){
+            for(int i=r.start;i<r.end;i++){
+                const cv::Range b=bandRows(i,n,rows), e=padRows(b,fieldReach,rows); cv::Mat dst=fieldTmp.rowRange(b);
+                cv::dilate(green.rowRange(e),bandA[i],fieldKernel,cv::Point(-1,-1),1,ISOLATED_BORDER,cv::morphologyDefaultBorderValue());
+                cv::erode(bandA[i],bandB[i],fieldKernel,cv::Point(-1,-1),4,ISOLATED_BORDER,cv::morphologyDefaultBorderValue());
+                bandB[i].rowRange(b.start-e.start,b.end-e.start).copyTo(dst);
+            }
+        });
+        fillField(); // the outline of the whole pitch crosses every band, so this step stays serial
+    }
+    PROFILE_SCOPE("detect.player_mask");
+    cv::parallel_for_(cv::Range(0,n),[&](const cv::Range &r){
+        for(int i=r.start;i<r.end;i++){
+            const cv::Range b=bandRows(i,n,rows), e=padRows(b,playerReach,rows);
+            cv::Mat dst=players.rowRange(b), both=combined.rowRange(b);
+            cv::bitwise_and(playerRaw.rowRange(e),field.rowRange(e),bandA[i]);
+            cv::dilate(bandA[i],bandB[i],playerKernel,cv::Point(-1,-1),1,ISOLATED_BORDER,cv::morphologyDefaultBorderValue());
+            bandB[i].rowRange(b.start-e.start,b.end-e.start).copyTo(dst);
+            cv::bitwise_and(fg.rowRange(b),dst,both);
+        }
+    });
+    if(debugWindows) showPlayers(frame);
+}
+
+void PlayerDetector::bandContours(int n){
+    const int rows=combined.rows, cols=combined.cols;
+    bandFound.resize(n);
+    cv::parallel_for_(cv::Range(0,n),[&](const cv::Range &r){
+        for(int i=r.start;i<r.end;i++){
+            const cv::Range b=bandRows(i,n,rows);
+            // Full chains: every seam pixel of a piece is recorded below.
+            cv::findContours(combined.rowRange(b),bandFound[i],cv::RETR_EXTERNAL,cv::CHAIN_APPROX_NONE,cv::Point(0,b.start));
+        }
+    });
+    PROFILE_SCOPE("detect.stitch");
+    // Pieces: contours touching a seam row. seamOwner holds, for seam s, the piece owning each pixel
+    // of the row above it (first cols entries) and of the row below it (next cols entries). Every
+    // foreground pixel of a band's edge row borders the outside, so it is on its piece's contour.
+    std::vector<cv::Rect> pieceBox; std::vector<uint64_t> pieceKey;
+    seamOwner.assign((size_t)std::max(0,n-1)*2*cols,-1);
+    for(int i=0;i<n;i++){
+        const cv::Range b=bandRows(i,n,rows);
+        for(size_t k=0;k<bandFound[i].size();k++){
+            const std::vector<cv::Point> &c=bandFound[i][k]; cv::Rect bb=cv::boundingRect(c);
+            bool top=i>0&&bb.y==b.start, bottom=i<n-1&&bb.br().y==b.end;
+            if(!top&&!bottom) continue;
+            int id=(int)pieceBox.size(); pieceBox.push_back(bb); pieceKey.push_back(startKey(c));
+            for(size_t j=0;j<c.size();j++){
+                if(bottom&&c[j].y==b.end-1) seamOwner[(size_t)i*2*cols+c[j].x]=id;
+                if(top&&c[j].y==b.start) seamOwner[(size_t)(i-1)*2*cols+cols+c[j].x]=id;
+            }
+        }
+    }
+    pieceParent.resize(pieceBox.size());
+    for(size_t p=0;p<pieceBox.size();p++) pieceParent[p]=(int)p;
+    for(int sIdx=0;sIdx<n-1;sIdx++){
+        const int *above=&seamOwner[(size_t)sIdx*2*cols], *below=above+cols;
+        for(int x=0;x<cols;x++){
+            if(above[x]<0) continue;
+            for(int dx=-1;dx<=1;dx++){
+                int xb=x+dx; if(xb<0||xb>=cols||below[xb]<0) continue;
+                int ra=findRoot(pieceParent,above[x]), rb=findRoot(pieceParent,below[xb]);
+                if(ra!=rb) pieceParent[std::max(ra,rb)]=std::min(ra,rb);
+            }
+        }
+    }
+    // Groups of joined pieces are whole components: bounding box and start pixel of the component.
+    std::vector<int> groupOf(pieceBox.size(),-1); std::vector<cv::Rect> groupBox; std::vector<uint64_t> groupKey;
+    for(size_t p=0;p<pieceBox.size();p++){
+        int root=findRoot(pieceParent,(int)p);
+        if(groupOf[root]<0){ groupOf[root]=(int)groupBox.size(); groupBox.push_back(pieceBox[p]); groupKey.push_back(pieceKey[p]); }
+        int g=groupOf[root]; groupOf[p]=g;
+        groupBox[g]|=pieceBox[p]; groupKey[g]=std::min(groupKey[g],pieceKey[p]);
+    }
+    const int groups=(int)groupBox.size();
+    groupFound.resize(groups); groupKeys.resize(groups);
+    cv::parallel_for_(cv::Range(0,groups),[&](const cv::Range &r){
+        for(int g=r.start;g<r.end;g++){
+            cv::findContours(combined(groupBox[g]),groupFound[g],cv::RETR_EXTERNAL,cv::CHAIN_APPROX_NONE,groupBox[g].tl());
+            groupKeys[g].clear();
+            for(size_t k=0;k<groupFound[g].size();k++) groupKeys[g].push_back(startKey(groupFound[g][k]));
+            std::sort(groupKeys[g].begin(),groupKeys[g].end());
+        }
+    });
+    // A contour is external unless the re-trace of a component enclosing its box does not list it.
+    auto enclosed=[&](uint64_t key,const cv::Rect &box,int self){
+        for(int g=0;g<groups;g++){
+            if(g==self||(groupBox[g]&box)!=box) continue;
+            if(!std::binary_search(groupKeys[g].begin(),groupKeys[g].end(),key)) return true;
+        }
+        return false;
+    };
+    for(int i=0;i<n;i++){
+        const cv::Range b=bandRows(i,n,rows);
+        for(size_t k=0;k<bandFound[i].size();k++){
+            const std::vector<cv::Point> &c=bandFound[i][k]; cv::Rect bb=cv::boundingRect(c);
+            if((i>0&&bb.y==b.start)||(i<n-1&&bb.br().y==b.end)) continue;
+            if(groups==0||!enclosed(startKey(c),bb,-1)) addCandidate(c);
+        }
+    }
+    for(int g=0;g<groups;g++){
+        if(enclosed(groupKey[g],groupBox[g],g)) continue;
+        for(size_t k=0;k<groupFound[g].size();k++)
+            if(startKey(groupFound[g][k])==groupKey[g]){ addCandidate(groupFound[g][k]); break; }
+    }
+}
+
+static inline int cellOf(int v,int cell){ return v<0?-1:v/cell; }
+
+void BoxGrid::build(const std::vector<cv::Rect> &boxes,int originX,int originY,int cellSize,int cols,int rows){
+    x0=originX; y0=originY; cell=cellSize; gw=cols; gh=rows;
+    start.assign((size_t)gw*gh+1,0);
+    int c0,r0,c1,r1;
+    for(size_t i=0;i<boxes.size();i++){
+        const cv::Rect &b=boxes[i];
+        cellSpan(b.x,b.y,b.x+std::max(b.width,1)-1,b.y+std::max(b.height,1)-1,c0,r0,c1,r1);
+        for(int r=r0;r<=r1;r++) for(int c=c0;c<=c1;c++) start[(size_t)r*gw+c+1]++;
+    }
+    for(size_t k=1;k<start.size();k++) start[k]+=start[k-1];
+    items.resize(start.back()); fill.assign(start.begin(),start.end()-1);
+    for(size_t i=0;i<boxes.size();i++){
+        const cv::Rect &b=boxes[i];
+        cellSpan(b.x,b.y,b.x+std::max(b.width,1)-1,b.y+std::max(b.height,1)-1,c0,r0,c1,r1);
+        for(int r=r0;r<=r1;r++) for(int c=c0;c<=c1;c++) items[fill[(size_t)r*gw+c]++]=(int)i;
+    }
+}
+
+void BoxGrid::cellSpan(int px0,int py0,int px1,int py1,int &c0,int &r0,int &c1,int &r1) const {
+    c0=std::min(std::max(cellOf(px0-x0,cell),0),gw-1); c1=std::min(std::max(cellOf(px1-x0,cell),0),gw-1);
+    r0=std::min(std::max(cellOf(py0-y0,cell),0),gh-1); r1=std::min(std::max(cellOf(py1-y0,cell),0),gh-1);
+}
+
+static inline int lowestBit(uint64_t v){
+#if defined(__GNUC__)
+    return __builtin_ctzll(v);
+#else
+    int k=0; while(!(v&1)){ v>>=1; k++; } return k;
+#endif
+}
+
+static inline bool touches(const cv::Rect &cur,const cv::Rect &o){
+    return (cur&o).area()>0||cur.contains(o.tl())||cur.contains(o.br())||o.contains(cur.tl())||o.contains(cur.br());
+}
+
+// Same result as the original all-pairs loop: boxes are grown in index order, each growth step
+// takes the lowest unused index at or after the scan position that touches the current box, and
+// the scan restarts from 0 until a full pass changes nothing. Only boxes in grid cells within one
+// pixel of the current box can touch it, so the scan walks a bitset of those candidates instead of
+// every box; the bitset is extended with the newly covered cells as the box grows.
+void PlayerDetector::mergeBoxes(const std::vector<cv::Rect> &inputBoxes,std::vector<cv::Rect> &out){
+    merged.clear(); out.clear();
+    const int n=(int)inputBoxes.size(); if(n==0) return;
+    int minX=INT_MAX,minY=INT_MAX,maxX=INT_MIN,maxY=INT_MIN; double meanSide=0;
+    for(int i=0;i<n;i++){
+        const cv::Rect &b=inputBoxes[i];
+        minX=std::min(minX,b.x); minY=std::min(minY,b.y);
+        maxX=std::max(maxX,b.x+std::max(b.width,1)); maxY=std::max(maxY,b.y+std::max(b.height,1));
+        meanSide+=std::max(b.width,b.height);
+    }
+    meanSide/=n;
+    // About one box per cell, but never more than ~4 cells per box.
+    const double spanX=maxX-minX+2.0, spanY=maxY-minY+2.0;
+    const int cell=std::max(8,std::max((int)meanSide,(int)std::ceil(std::sqrt(spanX*spanY/(4.0*n)))));
+    const int gw=(int)(spanX/cell)+1, gh=(int)(spanY/cell)+1;
+    inputGrid.build(inputBoxes,minX-1,minY-1,cell,gw,gh);
+
+    const int words=(n+63)/64;
+    used.assign(n,0); nearBits.assign(words,0);
+    for(int i=0;i<n;i++){
         if(used[i]) continue;
-        cv::Rect cur=inputBoxes[i]; bool changed;
-        do{
-            changed=false;
-            for(size_t j=0;j<inputBoxes.size();j++){
-                if(i==j||used[j]) continue;
-                cv::Rect o=inputBoxes[j];
-                if((cur&o).area()>0||cur.contains(o.tl())||cur.contains(o.br())||o.contains(cur.tl())||o.contains(cur.br())){
-                    cur=cur|o; used[j]=true; changed=true;
+        cv::Rect cur=inputBoxes[i];
+        int oc0=0,or0=0,oc1=-1,or1=-1; // cells already collected into nearBits
+        auto collect=[&](){
+            int c0,r0,c1,r1;
+            inputGrid.cellSpan(cur.x-1,cur.y-1,cur.x+cur.width,cur.y+cur.height,c0,r0,c1,r1);
+            auto addCells=[&](int r,int ca,int cb){
+                for(int c=ca;c<=cb;c++) for(const int *p=inputGrid.cellBegin(c,r);p!=inputGrid.cellEnd(c,r);++p){
+                    uint64_t bit=(uint64_t)1<<(*p&63);
+                    if(used[*p]||(nearBits[*p>>6]&bit)) continue;
+                    nearBits[*p>>6]|=bit; near.push_back(*p);
+                }
+            };
+            for(int r=r0;r<=r1;r++){
+                if(r<or0||r>or1) addCells(r,c0,c1);
+                else{ addCells(r,c0,std::min(c1,oc0-1)); addCells(r,std::max(c0,oc1+1),c1); }
+            }
+            oc0=c0; or0=r0; oc1=c1; or1=r1;
+        };
+        // Lowest candidate index >= pos that touches cur, or -1.
+        auto nextTouching=[&](int pos)->int{
+            for(int w=pos>>6;w<words;w++){
+                uint64_t bits=nearBits[w];
+                if(w==(pos>>6)) bits&=~(uint64_t)0<<(pos&63);
+                while(bits){
+                    int j=(w<<6)+lowestBit(bits); bits&=bits-1;
+                    if(j!=i&&!used[j]&&touches(cur,inputBoxes[j])) return j;
                 }
             }
-        }while(changed);
-        merged.push_back(cur); used[i]=true;
+            return -1;
+        };
+        collect();
+        bool changed=false; int pos=0;
+        for(;;){
+            int hit=pos<n?nextTouching(pos):-1;
+            if(hit>=0){
+                cur=cur|inputBoxes[hit]; used[hit]=1; nearBits[hit>>6]&=~((uint64_t)1<<(hit&63));
+                changed=true; pos=hit+1; collect(); continue;
+            }
+            if(!changed) break;
+            changed=false; pos=0;
+        }
+        merged.push_back(cur); used[i]=1;
+        for(size_t k=0;k<near.size();k++) nearBits[near[k]>>6]=0;
+        near.clear();
     }
-    std::vector<cv::Rect> cleaned;
+
+    // A merged box is dropped when another one contains both its corners; any such box covers its
+    // top-left pixel, so only the boxes listed in that cell need checking.
+    mergedGrid.build(merged,minX-1,minY-1,cell,gw,gh);
     for(size_t i=0;i<merged.size();i++){
-        bool inside=false;
-        for(size_t j=0;j<merged.size();j++){
-            if(i==j) continue;
-            if(merged[j].contains(merged[i].tl())&&merged[j].contains(merged[i].br())){ inside=true; break; }
+        int c0,r0,c1,r1; bool inside=false;
+        mergedGrid.cellSpan(merged[i].x,merged[i].y,merged[i].x,merged[i].y,c0,r0,c1,r1);
+        for(const int *p=mergedGrid.cellBegin(c0,r0);p!=mergedGrid.cellEnd(c0,r0);++p){
+            if(*p==(int)i) continue;
+            const cv::Rect &o=merged[*p];
+            if(o.contains(merged[i].tl())&&o.contains(merged[i].br())){ inside=true; break; }
+        }
+        if(!inside) out.push_back(merged[i]);
+    }
+}
+
+// Re-fits a box mapped up from the downscaled pass: inside a window one low-res pixel wider than
+// the box, keep full-resolution jersey pixels (not green, not near-black) that the low-res
+// foreground also covers, dilated like the low-res mask, and take their bounding rectangle.
+cv::Rect PlayerDetector::refineBox(const cv::Mat &frame,const cv::Rect &box){
+    const int m=(int)std::ceil(1.0/cfg.scale)+1;
+    cv::Rect win=cv::Rect(box.x-m,box.y-m,box.width+2*m,box.height+2*m)&cv::Rect(0,0,frame.cols,frame.rows);
+    if(win.area()<=0) return box;
+    cv::cvtColor(frame(win),roiHsv,cv::COLOR_BGR2HSV);
+    roiGreen.create(win.size(),CV_8UC1); roiMask.create(win.size(),CV_8UC1);
+    GreenMaskBody body(roiHsv,roiGreen,roiMask,cfg); body(cv::Range(0,roiHsv.rows));
+    cv::Rect lowWin(cvFloor(win.x*cfg.scale),cvFloor(win.y*cfg.scale),0,0);
+    lowWin.width=std::min(cvCeil(win.br().x*cfg.scale),combined.cols)-lowWin.x;
+    lowWin.height=std::min(cvCeil(win.br().y*cfg.scale),combined.rows)-lowWin.y;
+    if(lowWin.area()<=0) return box;
+    cv::resize(combined(lowWin),roiFgUp,cv::Size(),1.0/cfg.scale,1.0/cfg.scale,cv::INTER_NEAREST);
+    cv::Rect inUp(win.x-cvRound(lowWin.x/cfg.scale),win.y-cvRound(lowWin.y/cfg.scale),win.width,win.height);
+    inUp&=cv::Rect(0,0,roiFgUp.cols,roiFgUp.rows);
+    if(inUp.size()!=win.size()) return box;
+    cv::dilate(roiMask,roiMask,refineKernel);
+    cv::bitwise_and(roiMask,roiFgUp(inUp),roiMask);
+    cv::findNonZero(roiMask,roiPoints);
+    if(roiPoints.empty()) return box;
+    cv::Rect r=cv::boundingRect(roiPoints); r.x+=win.x; r.y+=win.y;
+    return r;
+}
+
+// Area and size filter on one contour at detection scale; keyed by its start pixel.
+void PlayerDetector::addCandidate(const std::vector<cv::Point> &contour){
+    const double s=cfg.scale;
+    double area=cv::contourArea(contour); if(area<cfg.minArea*s*s) return;
+    cv::Rect b=cv::boundingRect(contour);
+    if(b.width<cfg.minWidth*s||b.height<cfg.minHeight*s||b.width>cfg.maxWidth*s||b.height>cfg.maxHeight*s) return;
+    keyed.push_back(std::make_pair(startKey(contour),b));
+}
+
+void PlayerDetector::detect(const cv::Mat &frame,std::vector<cv::Rect> &out){
+    const double s=cfg.scale;
+    const cv::Mat *src=&frame; inputSize=frame.size();
+    if(s<1.0){ PROFILE_SCOPE("detect.resize"); cv::resize(frame,small,cv::Size(),s,s,cv::INTER_AREA); src=&small; }
+    {
+        PROFILE_SCOPE("detect.background");
+        // Dropped frames would each have moved the background by learningRate.
+        double rate=cfg.learningRate;
+        if(skippedFrames>0&&rate>0&&rate<1) rate=1.0-std::pow(1.0-rate,skippedFrames+1);
+        skippedFrames=0;
+        bgSub->apply(*src,fg,rate);
+    }
+    const bool incremental=cfg.fieldRefresh>0;
+    // Incremental mode masks only foreground tiles; bands apply to full-frame masking only.
+    const int bands=incremental?1:std::min(cfg.bands<0?cv::getNumThreads():cfg.bands,src->rows);
+    if(incremental) incrementalMasks(*src); else if(bands>1) bandMasks(*src,bands); else computeMasks(*src);
+    detStats.frames++;
+    {
+        PROFILE_SCOPE("detect.contours");
+        keyed.clear();
+        if(bands>1) bandContours(bands);
+        else{
+            if(!incremental) cv::bitwise_and(fg,players,combined);
+            cv::findContours(combined,contours,cv::RETR_EXTERNAL,cv::CHAIN_APPROX_SIMPLE);
+            for(size_t i=0;i<contours.size();i++) addCandidate(contours[i]);
+        }
+        // mergeBoxes depends on input order: candidates go in bottom to top by start pixel, the
+        // order findContours reports them in, whichever way they were traced.
+        std::sort(keyed.begin(),keyed.end(),[](const std::pair<uint64_t,cv::Rect> &a,const std::pair<uint64_t,cv::Rect> &b){ return a.first>b.first; });
+        candidates.clear();
+        const cv::Rect full(0,0,frame.cols,frame.rows);
+        for(size_t i=0;i<keyed.size();i++){
+            cv::Rect b=keyed[i].second;
+            if(s<1.0){
+                int x0=cvFloor(b.x/s), y0=cvFloor(b.y/s), x1=cvCeil(b.br().x/s), y1=cvCeil(b.br().y/s);
+                b=cv::Rect(x0,y0,x1-x0,y1-y0)&full;
+                if(b.area()<=0) continue;
+            }
+            candidates.push_back(b);
         }
-        if(!inside) cleaned.push_back(merged[i]);
-    }
-    return cleaned;
-}
-
-std::vector<cv::Rect> detectPlayers(const cv::Mat &frame, cv::Ptr<cv::BackgroundSubtractor> &bgSub){
-    cv::Mat fgMask,hsv,fieldMask,fieldMaskedBgr,playersMask,combined;
-    bgSub->apply(frame,fgMask,0.01);
-    cv::cvtColor(frame,hsv,cv::COLOR_BGR2HSV);
-    fieldMask=maskGreenField(hsv);
-    fieldMaskedBgr=cv::Mat::zeros(frame.size(),frame.type());
-    frame.copyTo(fieldMaskedBgr,fieldMask);
-    playersMask=maskGreenPlayers(fieldMaskedBgr);
-    cv::bitwise_and(fgMask,playersMask,combined);
-    std::vector<std::vector<cv::Point> > contours; std::vector<cv::Rect> boxes;
-    cv::findContours(combined,contours,cv::RETR_EXTERNAL,cv::CHAIN_APPROX_SIMPLE);
-    for(size_t i=0;i<contours.size();i++){
-        double area=cv::contourArea(contours[i]); if(area<30) continue;
-        cv::Rect b=cv::boundingRect(contours[i]);
-        if(b.width<10||b.height<20||b.width>100||b.height>200) continue;
-        boxes.push_back(b);
     }
-    return mergeBoxes(boxes);
+    { PROFILE_SCOPE("detect.merge"); mergeBoxes(candidates,out); }
+    if(s<1.0&&cfg.refine){ PROFILE_SCOPE("detect.refine"); for(size_t i=0;i<out.size();i++) out[i]=refineBox(frame,out[i]); }
 }
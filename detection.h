@@ -9,6 +9,102 @@
 #ifndef DETECTION_H
 #define DETECTION_H
 #include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
 #include <vector>
-std::vector<cv::Rect> detectPlayers(const cv::Mat &frame, cv::Ptr<cv::BackgroundSubtractor> &bgSub);
+// Uniform grid over a set of boxes; every cell lists (CSR style) the boxes whose pixels overlap it.
+class BoxGrid{
+    std::vector<int> start,items,fill; int x0,y0,cell,gw,gh;
+public:
+    BoxGrid():x0(0),y0(0),cell(1),gw(0),gh(0){}
+    void build(const std::vector<cv::Rect> &boxes,int originX,int originY,int cellSize,int cols,int rows);
+    // Cells overlapping the inclusive pixel span [px0,px1]x[py0,py1], clamped to the grid.
+    void cellSpan(int px0,int py0,int px1,int py1,int &c0,int &r0,int &c1,int &r1) const;
+    const int *cellBegin(int c,int r) const { return items.data()+start[(size_t)r*gw+c]; }
+    const int *cellEnd(int c,int r) const { return items.data()+start[(size_t)r*gw+c+1]; }
+};
+
+// Detection is done on the frame resized by `scale` (e.g. 0.5 or 0.25 for 1080p/4K): background
+// model, masks, morphology and contours all run at that size, pixel thresholds scale with it and
+// boxes are mapped back to full resolution. `refine` re-fits each box against a full-resolution
+// jersey mask in a small window around it. Pixel sizes and areas below are at full resolution.
+struct DetectorConfig{
+    double scale=1.0; bool refine=false;
+    int background=0;                 // background model (background.h): 0 MOG2, 1 running average
+    int mogHistory=500; double mogVarThreshold=16,learningRate=0.01;   // MOG2 background model (history and rate: both models)
+    double bgThreshold=20;            // running average: smallest colour difference that is foreground
+    int greenHMin=40,greenHMax=90,greenSMin=40,greenSMax=255,greenVMin=40,greenVMax=255; // pitch colour (OpenCV HSV)
+    int blackMax=10;                  // H,S,V all <= blackMax is near-black, never a jersey
+    double fieldMinArea=1000;         // smaller green regions are not pitch
+    double minArea=30; int minWidth=10,minHeight=20,maxWidth=100,maxHeight=200; // player contour filter
+    int dilate=5;                     // jersey mask dilation radius
+    int fieldRefresh=0;               // incremental mode when > 0: the field mask is reused for up to this many frames...
+    double fieldMotion=0.03;          // ...or until this fraction of the pitch colour mask changed (camera motion)
+    int bands=0;                      // > 1: process each frame as this many row bands in parallel (-1: one per OpenCV thread); off with fieldRefresh
+};
+// Parameters by the names used in config files (snake_case of the fields above, e.g. learning_rate).
+const std::vector<std::string> &detectorParamNames();
+bool setDetectorParam(DetectorConfig &cfg,const std::string &key,double value);
+bool getDetectorParam(const DetectorConfig &cfg,const std::string &key,double &value);
+// Applies every key of a cv::FileStorage map node; keys that are absent keep their value.
+bool readDetectorConfig(const cv::FileNode &node,DetectorConfig &cfg,std::string *error=nullptr);
+bool loadDetectorConfig(const std::string &path,DetectorConfig &cfg,std::string *error=nullptr);
+bool saveDetectorConfig(const std::string &path,const DetectorConfig &cfg);
+
+// What the incremental mode saved: field masks recomputed (early ones on camera motion) and the
+// 64x64 tiles, at detection scale, on which the jersey mask was built.
+struct DetectorStats{ long frames=0,fieldRefreshes=0,motionRefreshes=0; long long tiles=0,activeTiles=0; };
+
+// Per-stream detector: owns the background model, the structuring elements and every working
+// buffer, so after the first frame of a given size detect() reuses all of its storage.
+class PlayerDetector{
+    cv::Ptr<cv::BackgroundSubtractor> bgSub; cv::Mat fieldKernel,playerKernel,refineKernel;
+    DetectorConfig cfg; cv::Mat small,hsv,green,playerRaw,fieldTmp,field,players,fg,combined;
+    cv::Mat roiHsv,roiGreen,roiMask,roiFgUp; std::vector<cv::Point> roiPoints;
+    std::vector<std::vector<cv::Point> > contours; std::vector<cv::Rect> candidates,merged; std::vector<char> used;
+    BoxGrid inputGrid,mergedGrid; std::vector<int> near; std::vector<uint64_t> nearBits;
+    cv::Mat refGreen,tileBuf,tileDilBuf; std::vector<char> tileOn; int fieldAge=-1; DetectorStats detStats;
+    std::vector<std::pair<uint64_t,cv::Rect> > keyed; // accepted contours by start pixel (see detect())
+    std::vector<cv::Mat> bandA,bandB; std::vector<std::vector<std::vector<cv::Point> > > bandFound,groupFound;
+    std::vector<int> seamOwner,pieceParent; std::vector<std::vector<uint64_t> > groupKeys;
+    int skippedFrames=0; cv::Size inputSize; bool debugWindows;
+    void buildKernels();
+    void incrementalMasks(const cv::Mat &frame);
+    void bandMasks(const cv::Mat &frame,int n);
+    void bandContours(int n);
+    void fillField();
+    void addCandidate(const std::vector<cv::Point> &contour);
+    void showPlayers(const cv::Mat &frame);
+    cv::Rect refineBox(const cv::Mat &frame,const cv::Rect &box);
+public:
+    // The first constructor builds the background model config.background selects; the second
+    // takes any cv::BackgroundSubtractor.
+    explicit PlayerDetector(const DetectorConfig &config=DetectorConfig());
+    PlayerDetector(const cv::Ptr<cv::BackgroundSubtractor> &bg,const DetectorConfig &config=DetectorConfig());
+    const DetectorConfig &config() const { return cfg; }
+    const DetectorStats &stats() const { return detStats; }
+    // With fieldRefresh > 0 the field mask is cached and the jersey mask is only built where MOG2
+    // found foreground (see incrementalMasks); otherwise every mask is recomputed per frame. With
+    // bands > 1 masks and contours are computed per row band in parallel, with identical output.
+    void detect(const cv::Mat &frame,std::vector<cv::Rect> &out);
+    // Pitch mask and dilated jersey mask of a BGR frame, from a single HSV conversion. The masks
+    // have the size of the frame passed in (detect() passes the downscaled frame).
+    void computeMasks(const cv::Mat &frame);
+    // The two steps of computeMasks after the colour pass. They only read the colour masks of the
+    // last computeMasks call, so they can be re-run on their own (bench times them this way).
+    void maskGreenField();
+    void maskGreenPlayers(const cv::Mat &frame);
+    const cv::Mat &fieldMask() const { return field; }
+    const cv::Mat &playersMask() const { return players; }
+    // Grows each box by every box that overlaps or corner-touches it (rescanning until stable),
+    // then drops merged boxes lying inside another one. Candidates come from a uniform grid.
+    void mergeBoxes(const std::vector<cv::Rect> &inputBoxes,std::vector<cv::Rect> &out);
+    // Live mode: n frames were dropped before the next detect(), which then applies the background
+    // learning those frames would have had. setScale() changes the detection scale mid-stream and
+    // re-initialises the background model from its own background image at the new size.
+    void skipFrames(int n){ skippedFrames+=n; }
+    void setScale(double scale);
+    // Debug windows ("Green Field Mask", "Players") are off unless enabled here.
+    void setDebug(bool enabled){ debugWindows=enabled; }
+};
 #endif
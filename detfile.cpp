@@ -0,0 +1,122 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#include "detfile.h"
+#include <algorithm>
+#include <cstring>
+#if defined(__unix__)||defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DETFILE_MMAP 1
+#endif
+
+static const char MAGIC[8]={'S','V','A','D','E','T','\0','\0'};
+static const uint32_t VERSION=1;
+static const size_t BUFFER_RECORDS=4096;
+
+static uint64_t indexOffsetFor(uint64_t records){ return (sizeof(DetFileHeader)+records*sizeof(DetRecord)+7)/8*8; }
+
+bool DetectionWriter::open(const std::string &path,uint32_t flags){
+    close();
+    out.open(path,std::ios::binary|std::ios::trunc); if(!out) return false;
+    fileFlags=flags; count=0; failed=false; buffer.clear(); index.clear(); buffer.reserve(BUFFER_RECORDS);
+    DetFileHeader h; std::memset(&h,0,sizeof(h)); // placeholder until close()
+    out.write((const char*)&h,sizeof(h));
+    return (bool)out;
+}
+
+bool DetectionWriter::flush(){
+    if(!buffer.empty()) out.write((const char*)buffer.data(),buffer.size()*sizeof(DetRecord));
+    buffer.clear();
+    if(!out) failed=true;
+    return !failed;
+}
+
+bool DetectionWriter::add(const DetRecord &r){
+    if(!out.is_open()||failed) return false;
+    if(!index.empty()&&r.frame<index.back().frame){ failed=true; return false; }
+    if(index.empty()||r.frame!=index.back().frame){ DetFrameIndex e; e.frame=r.frame; e.reserved=0; e.begin=count; index.push_back(e); }
+    buffer.push_back(r); count++;
+    return buffer.size()<BUFFER_RECORDS||flush();
+}
+
+bool DetectionWriter::close(){
+    if(!out.is_open()) return !failed;
+    // After a failure the placeholder header stays, so readers reject the file.
+    if(failed||!flush()){ out.close(); return false; }
+    static const char zeros[8]={0};
+    uint64_t at=sizeof(DetFileHeader)+count*sizeof(DetRecord), indexAt=indexOffsetFor(count);
+    out.write(zeros,(std::streamsize)(indexAt-at));
+    if(!index.empty()) out.write((const char*)index.data(),index.size()*sizeof(DetFrameIndex));
+    DetFileHeader h; std::memset(&h,0,sizeof(h));
+    std::memcpy(h.magic,MAGIC,sizeof(MAGIC)); h.version=VERSION; h.flags=fileFlags;
+    h.recordCount=count; h.frameCount=index.size(); h.indexOffset=indexAt;
+    out.seekp(0); out.write((const char*)&h,sizeof(h));
+    if(!out) failed=true;
+    out.close();
+    return !failed;
+}
+
+bool DetectionReader::open(const std::string &path,std::string *error){
+    close();
+    auto fail=[&](const std::string &why){ close(); if(error) *error=path+": "+why; return false; };
+#ifdef DETFILE_MMAP
+    int fd=::open(path.c_str(),O_RDONLY); if(fd<0) return fail("cannot open");
+    struct stat st; if(fstat(fd,&st)!=0){ ::close(fd); return fail("cannot stat"); }
+    length=(size_t)st.st_size;
+    if(length>=sizeof(DetFileHeader)){
+        void *p=mmap(nullptr,length,PROT_READ,MAP_PRIVATE,fd,0);
+        if(p!=MAP_FAILED){ base=(const unsigned char*)p; mapped=true; }
+    }
+    ::close(fd);
+    if(!mapped) return fail("cannot map (too short?)");
+#else
+    std::ifstream in(path,std::ios::binary); if(!in) return fail("cannot open");
+    copy.assign(std::istreambuf_iterator<char>(in),std::istreambuf_iterator<char>());
+    base=copy.data(); length=copy.size();
+#endif
+    if(length<sizeof(DetFileHeader)) return fail("too short");
+    hdr=(const DetFileHeader*)base;
+    if(std::memcmp(hdr->magic,MAGIC,sizeof(MAGIC))!=0) return fail("not a detection file");
+    if(hdr->version!=VERSION) return fail("unsupported version "+std::to_string(hdr->version));
+    if(hdr->indexOffset!=indexOffsetFor(hdr->recordCount)||hdr->indexOffset+hdr->frameCount*sizeof(DetFrameIndex)>length) return fail("truncated");
+    recs=(const DetRecord*)(base+sizeof(DetFileHeader));
+    idx=(const DetFrameIndex*)(base+hdr->indexOffset);
+    // frameAt() trusts the record offsets and frame() binary-searches the frame numbers.
+    for(uint64_t i=0;i<hdr->frameCount;i++){
+        if(idx[i].begin>hdr->recordCount||(i>0&&(idx[i].begin<idx[i-1].begin||idx[i].frame<idx[i-1].frame))) return fail("corrupt frame index");
+    }
+    return true;
+}
+
+void DetectionReader::close(){
+#ifdef DETFILE_MMAP
+    if(mapped) munmap((void*)base,length);
+#endif
+    copy.clear(); copy.shrink_to_fit();
+    base=nullptr; length=0; mapped=false; hdr=nullptr; recs=nullptr; idx=nullptr;
+}
+
+std::pair<const DetRecord*,const DetRecord*> DetectionReader::frameAt(size_t i) const {
+    uint64_t b=idx[i].begin, e=i+1<frameCount()?idx[i+1].begin:hdr->recordCount;
+    return std::make_pair(recs+b,recs+e);
+}
+
+std::pair<const DetRecord*,const DetRecord*> DetectionReader::frame(int f) const {
+    const DetFrameIndex *end=idx+frameCount();
+    const DetFrameIndex *it=std::lower_bound(idx,end,f,[](const DetFrameIndex &e,int v){ return e.frame<v; });
+    if(it==end||it->frame!=f) return std::make_pair(recs,recs);
+    return frameAt((size_t)(it-idx));
+}
+
+bool DetectionReader::isDetectionFile(const std::string &path){
+    std::ifstream in(path,std::ios::binary); char m[8];
+    return in.read(m,sizeof(m))&&std::memcmp(m,MAGIC,sizeof(MAGIC))==0;
+}
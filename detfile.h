@@ -0,0 +1,65 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#ifndef DETFILE_H
+#define DETFILE_H
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Binary detection file (.bin), the compact counterpart of ours.csv / yolo.csv:
+//   header | records, sorted by frame | padding to 8 bytes | frame index
+// Records are fixed width, so the file can be memory-mapped and read in place. Each index entry
+// is a frame number and its first record; a frame ends where the next entry begins. All fields
+// are little-endian, which is what every platform we run on uses.
+enum DetFileFlags{ DET_HAS_TEAM=1, DET_HAS_TRACK=2 };
+struct DetFileHeader{ char magic[8]; uint32_t version,flags; uint64_t recordCount,frameCount,indexOffset; };
+struct DetRecord{ int32_t frame; float x1,y1,x2,y2; int32_t team,trackId; };  // team/trackId -1 when absent
+struct DetFrameIndex{ int32_t frame; uint32_t reserved; uint64_t begin; };
+
+class DetectionWriter{
+    std::ofstream out; uint32_t fileFlags=0; uint64_t count=0; bool failed=false;
+    std::vector<DetRecord> buffer; std::vector<DetFrameIndex> index;
+    bool flush();
+public:
+    DetectionWriter(){}
+    DetectionWriter(const DetectionWriter&)=delete; DetectionWriter &operator=(const DetectionWriter&)=delete;
+    ~DetectionWriter(){ close(); }
+    bool open(const std::string &path,uint32_t flags);
+    bool isOpen() const { return out.is_open(); }
+    // Frames must not decrease; false otherwise, and close() then leaves the file unreadable.
+    bool add(const DetRecord &r);
+    // Writes the index and the final header; false, without them, if anything failed along the way.
+    bool close();
+};
+
+class DetectionReader{
+    const unsigned char *base=nullptr; size_t length=0; bool mapped=false; std::vector<unsigned char> copy;
+    const DetFileHeader *hdr=nullptr; const DetRecord *recs=nullptr; const DetFrameIndex *idx=nullptr;
+public:
+    DetectionReader(){}
+    DetectionReader(const DetectionReader&)=delete; DetectionReader &operator=(const DetectionReader&)=delete;
+    ~DetectionReader(){ close(); }
+    // Maps the file read-only (reads it into memory where mmap is unavailable) and validates it.
+    bool open(const std::string &path,std::string *error=nullptr);
+    void close();
+    uint32_t flags() const { return hdr?hdr->flags:0; }
+    size_t size() const { return hdr?(size_t)hdr->recordCount:0; }
+    const DetRecord *records() const { return recs; }
+    size_t frameCount() const { return hdr?(size_t)hdr->frameCount:0; }
+    const DetFrameIndex *frames() const { return idx; }
+    // Records of the i-th indexed frame, and of frame number f (empty range when it has none).
+    std::pair<const DetRecord*,const DetRecord*> frameAt(size_t i) const;
+    std::pair<const DetRecord*,const DetRecord*> frame(int f) const;
+    // True when the file starts with the detection-file magic, whatever its extension.
+    static bool isDetectionFile(const std::string &path);
+};
+#endif
@@ -7,216 +7,99 @@
          No external source code beyond standard libraries and OpenCV.
 ********************************************************************************/
 // eval_iou.cpp
-// Usage: ./eval_iou <ours.csv> <yolo.csv> [iou_thr=0.5] [ours_offset=0] [yolo_offset=0]
-#include <algorithm>
-#include <fstream>
+// Usage: ./eval_iou <ours.csv|ours.bin> <yolo.csv|yolo.bin> [iou_thr=0.5] [ours_offset=0] [yolo_offset=0]
+//                   [--sweep lo:hi:step] [--threads N]
+// Matching and file loading live in evaluation.cpp; --sweep reports every threshold from one pass.
+#include <cstdio>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
-#include <map>
-#include <numeric>
-#include <set>
-#include <sstream>
 #include <string>
 #include <vector>
+#include "evaluation.h"
 
-struct Box
+static void usage(const char *prog)
 {
-    double x1, y1, x2, y2;
-};
-
-static inline void strip_cr(std::string &s)
-{
-    if (!s.empty() && s.back() == '\r')
-        s.pop_back();
-}
-static inline void strip_bom(std::string &s)
-{
-    const unsigned char bom[3] = {0xEF, 0xBB, 0xBF};
-    if (s.size() >= 3 &&
-        (unsigned char)s[0] == bom[0] &&
-        (unsigned char)s[1] == bom[1] &&
-        (unsigned char)s[2] == bom[2])
-    {
-        s.erase(0, 3);
-    }
-}
-static inline bool is_header_like(const std::vector<std::string> &t)
-{
-    if (t.size() < 5)
-        return true;
-    // crude check: any token has alpha
-    for (const auto &x : t)
-    {
-        for (char c : x)
-            if (std::isalpha((unsigned char)c))
-                return true;
-    }
-    return false;
-}
-static inline std::vector<std::string> split_csv(const std::string &line)
-{
-    // simple CSV split (no quoted fields in our use-case)
-    std::vector<std::string> out;
-    std::stringstream ss(line);
-    std::string tok;
-    while (std::getline(ss, tok, ','))
-    {
-        // trim surrounding spaces
-        size_t a = tok.find_first_not_of(" \t");
-        size_t b = tok.find_last_not_of(" \t");
-        if (a == std::string::npos)
-            out.emplace_back("");
-        else
-            out.emplace_back(tok.substr(a, b - a + 1));
-    }
-    return out;
+    std::cerr
+        << "Usage: " << prog
+        << " <ours.csv|ours.bin> <yolo.csv|yolo.bin> [iou_thr=0.5] [ours_offset=0] [yolo_offset=0]\n"
+        << "       [--sweep lo:hi:step] [--threads N]\n"
+        << "  --sweep    report metrics for every IoU threshold lo, lo+step, ..., hi (IoUs computed once)\n"
+        << "  --threads  worker threads for per-frame matching (default: all cores)\n";
 }
 
-static double iou(const Box &a, const Box &b)
-{
-    const double x1 = std::max(a.x1, b.x1);
-    const double y1 = std::max(a.y1, b.y1);
-    const double x2 = std::min(a.x2, b.x2);
-    const double y2 = std::min(a.y2, b.y2);
-    const double inter = std::max(0.0, x2 - x1) * std::max(0.0, y2 - y1);
-    const double a1 = std::max(0.0, a.x2 - a.x1) * std::max(0.0, a.y2 - a.y1);
-    const double a2 = std::max(0.0, b.x2 - b.x1) * std::max(0.0, b.y2 - b.y1);
-    const double uni = a1 + a2 - inter;
-    return uni > 0 ? inter / uni : 0.0;
-}
-
-static void load_csv_5cols(const std::string &path,
-                           std::map<int, std::vector<Box>> &by_frame,
-                           int frame_offset)
+int main(int argc, char **argv)
 {
-    std::ifstream f(path);
-    if (!f.is_open())
+    std::vector<std::string> pos;
+    std::vector<double> sweep;
+    int threads = 0;
+    for (int i = 1; i < argc; ++i)
     {
-        throw std::runtime_error("Cannot open " + path);
-    }
-
-    std::string line;
-    bool first = true;
-    while (std::getline(f, line))
-    {
-        strip_cr(line);
-        if (line.empty())
-            continue;
-
-        if (first)
-        {
-            strip_bom(line);
-            first = false;
-        }
-        if (line.size() && line[0] == '#')
-            continue;
-
-        auto t = split_csv(line);
-        if (t.size() < 5)
-            continue;
-        if (is_header_like(t))
-            continue; // skip header-like lines anywhere
-
-        try
+        const std::string a = argv[i];
+        if (a == "--sweep" && i + 1 < argc)
         {
-            int frame = std::stoi(t[0]) + frame_offset;
-            Box b{std::stod(t[1]), std::stod(t[2]), std::stod(t[3]), std::stod(t[4])};
-            by_frame[frame].push_back(b);
+            double lo, hi, step;
+            if (std::sscanf(argv[++i], "%lf:%lf:%lf", &lo, &hi, &step) != 3 || step <= 0 || lo <= 0 || hi < lo)
+            {
+                std::cerr << "Bad --sweep range, expected lo:hi:step with 0 < lo <= hi\n";
+                return 1;
+            }
+            for (int k = 0; lo + k * step <= hi + 1e-9; ++k)
+                sweep.push_back(lo + k * step);
         }
-        catch (...)
+        else if (a == "--threads" && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if (a.compare(0, 2, "--") == 0)
         {
-            // ignore malformed rows
-            continue;
+            usage(argv[0]);
+            return 1;
         }
+        else
+            pos.push_back(a);
     }
-}
-
-int main(int argc, char **argv)
-{
-    if (argc < 3)
+    if (pos.size() < 2)
     {
-        std::cerr
-            << "Usage: " << argv[0]
-            << " <ours.csv> <yolo.csv> [iou_thr=0.5] [ours_offset=0] [yolo_offset=0]\n";
+        usage(argv[0]);
         return 1;
     }
-    const std::string ours_path = argv[1];
-    const std::string yolo_path = argv[2];
-    const double thr = (argc >= 4) ? std::stod(argv[3]) : 0.5;
-    const int off_ours = (argc >= 5) ? std::stoi(argv[4]) : 0;
-    const int off_yolo = (argc >= 6) ? std::stoi(argv[5]) : 0;
-
-    std::map<int, std::vector<Box>> ours, yolo;
-    try
+    const double thr = (pos.size() >= 3) ? std::stod(pos[2]) : 0.5;
+    if (thr <= 0)
     {
-        load_csv_5cols(ours_path, ours, off_ours);
-        load_csv_5cols(yolo_path, yolo, off_yolo);
+        std::cerr << "IoU threshold must be > 0\n";
+        return 1;
     }
-    catch (const std::exception &e)
+    const int off_ours = (pos.size() >= 4) ? std::stoi(pos[3]) : 0;
+    const int off_yolo = (pos.size() >= 5) ? std::stoi(pos[4]) : 0;
+
+    FrameBoxes ours, yolo;
+    std::string err;
+    if (!loadFrameBoxes(pos[0], off_ours, ours, &err) || !loadFrameBoxes(pos[1], off_yolo, yolo, &err))
     {
-        std::cerr << "Load error: " << e.what() << "\n";
+        std::cerr << "Load error: " << err << "\n";
         return 2;
     }
 
-    long TP = 0, FP = 0, FN = 0;
-    std::vector<double> matched_ious;
-
-    std::set<int> frames;
-    for (auto &kv : ours)
-        frames.insert(kv.first);
-    for (auto &kv : yolo)
-        frames.insert(kv.first);
-
-    for (int f : frames)
+    if (sweep.empty())
     {
-        auto &P = ours[f]; // predictions
-        auto &G = yolo[f]; // ground truth (YOLO)
-        std::vector<char> used(G.size(), 0);
-
-        for (const auto &pb : P)
-        {
-            double best = 0.0;
-            int best_j = -1;
-            for (int j = 0; j < (int)G.size(); ++j)
-            {
-                if (used[j])
-                    continue;
-                double v = iou(pb, G[j]);
-                if (v > best)
-                {
-                    best = v;
-                    best_j = j;
-                }
-            }
-            if (best >= thr)
-            {
-                TP++;
-                used[best_j] = 1;
-                matched_ious.push_back(best);
-            }
-            else
-            {
-                FP++;
-            }
-        }
-        for (int j = 0; j < (int)G.size(); ++j)
-            if (!used[j])
-                FN++;
+        const EvalCounts c = evaluate(ours, yolo, std::vector<double>(1, thr), threads)[0];
+        std::cout << "TP=" << c.tp << " FP=" << c.fp << " FN=" << c.fn << "\n";
+        std::cout << std::fixed << std::setprecision(3)
+                  << "Precision=" << c.precision()
+                  << " Recall=" << c.recall()
+                  << " F1=" << c.f1()
+                  << " mIoU=" << c.meanIou() << "\n";
+        return 0;
     }
 
-    const double precision = (TP + FP) ? double(TP) / (TP + FP) : 0.0;
-    const double recall = (TP + FN) ? double(TP) / (TP + FN) : 0.0;
-    const double f1 = (precision + recall) ? 2 * precision * recall / (precision + recall) : 0.0;
-    const double miou = matched_ious.empty()
-                            ? 0.0
-                            : std::accumulate(matched_ious.begin(), matched_ious.end(), 0.0) / matched_ious.size();
-
-    std::cout << "TP=" << TP << " FP=" << FP << " FN=" << FN << "\n";
-    std::cout << std::fixed << std::setprecision(3)
-              << "Precision=" << precision
-              << " Recall=" << recall
-              << " F1=" << f1
-              << " mIoU=" << miou << "\n";
-
+    const std::vector<EvalCounts> res = evaluate(ours, yolo, sweep, threads);
+    std::cout << "  IoU       TP       FP       FN  Precision  Recall     F1   mIoU\n";
+    for (size_t t = 0; t < sweep.size(); ++t)
+    {
+        const EvalCounts &c = res[t];
+        std::cout << std::fixed << std::setprecision(2) << std::setw(5) << sweep[t]
+                  << std::setw(9) << c.tp << std::setw(9) << c.fp << std::setw(9) << c.fn
+                  << std::setprecision(3) << std::setw(11) << c.precision() << std::setw(8) << c.recall()
+                  << std::setw(7) << c.f1() << std::setw(7) << c.meanIou() << "\n";
+    }
     return 0;
 }
@@ -0,0 +1,181 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#include "evaluation.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include "detfile.h"
+
+// Frame range a single file may span; guards the flat per-frame offsets against garbage frame numbers.
+static const long MAX_FRAME_SPAN=1L<<26;
+static const int CHUNK_FRAMES=256;
+
+struct Row{ int frame; EvalBox box; };
+
+// Counting sort by frame into the flat layout; rows of one frame keep their file order.
+static bool buildFrameBoxes(const std::vector<Row> &rows,FrameBoxes &out,std::string *error,const std::string &path){
+    out=FrameBoxes();
+    if(rows.empty()){ out.start.assign(1,0); return true; }
+    int lo=INT_MAX,hi=INT_MIN;
+    for(size_t i=0;i<rows.size();i++){ lo=std::min(lo,rows[i].frame); hi=std::max(hi,rows[i].frame); }
+    if((long)hi-lo>=MAX_FRAME_SPAN){ if(error) *error=path+": frame numbers span more than "+std::to_string(MAX_FRAME_SPAN); return false; }
+    int n=hi-lo+1;
+    out.firstFrame=lo; out.start.assign(n+1,0); out.boxes.resize(rows.size());
+    for(size_t i=0;i<rows.size();i++) out.start[rows[i].frame-lo+1]++;
+    for(int i=0;i<n;i++) out.start[i+1]+=out.start[i];
+    std::vector<uint32_t> fill(out.start.begin(),out.start.end()-1);
+    for(size_t i=0;i<rows.size();i++) out.boxes[fill[rows[i].frame-lo]++]=rows[i].box;
+    return true;
+}
+
+FrameBoxes FrameBoxes::slice(int first,int last) const {
+    FrameBoxes out; out.firstFrame=first; out.start.assign(1,0);
+    for(int f=first;f<last;f++){
+        int i=f-firstFrame;
+        if(i>=0&&i<frameCount()) out.appendFrame(begin(i),count(i)); else out.appendFrame(nullptr,0);
+    }
+    return out;
+}
+
+static inline bool isBlank(char c){ return c==' '||c=='\t'; }
+
+bool parseLeadingInt(const char *b,const char *e,int &v){
+    bool neg=false; if(b<e&&(*b=='+'||*b=='-')){ neg=*b=='-'; b++; }
+    if(b==e||!std::isdigit((unsigned char)*b)) return false;
+    long long x=0;
+    for(;b<e&&std::isdigit((unsigned char)*b);b++){ x=x*10+(*b-'0'); if(x>(long long)INT_MAX+1) return false; }
+    x=neg?-x:x; if(x<INT_MIN||x>INT_MAX) return false;
+    v=(int)x; return true;
+}
+
+// Up to 15 significant digits the result is one correctly rounded division, the same as strtod;
+// longer mantissas and exponents go through strtod.
+bool parseLeadingDouble(const char *b,const char *e,double &v){
+    static const double POW10[]={1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+    const char *s=b; bool neg=false; if(b<e&&(*b=='+'||*b=='-')){ neg=*b=='-'; b++; }
+    unsigned long long m=0; int digits=0,frac=0; bool any=false;
+    for(;b<e&&std::isdigit((unsigned char)*b);b++){ any=true; if(m||*b!='0'){ m=m*10+(*b-'0'); digits++; } if(digits>15) break; }
+    if(digits<=15&&b<e&&*b=='.'){
+        for(b++;b<e&&std::isdigit((unsigned char)*b);b++){ any=true; if(m||*b!='0') digits++; m=m*10+(*b-'0'); frac++; if(digits>15||frac>22) break; }
+    }
+    if(!any) return false;
+    if(digits>15||frac>22||(b<e&&(*b=='e'||*b=='E'))){
+        char buf[64]; size_t n=std::min((size_t)(e-s),sizeof(buf)-1); std::memcpy(buf,s,n); buf[n]=0;
+        v=std::strtod(buf,nullptr); return true;
+    }
+    v=(double)m/POW10[frac]; if(neg) v=-v;
+    return true;
+}
+
+static bool loadCsv(const std::string &path,int frameOffset,std::vector<Row> &rows,std::string *error){
+    std::ifstream in(path,std::ios::binary);
+    if(!in){ if(error) *error="Cannot open "+path; return false; }
+    std::string text((std::istreambuf_iterator<char>(in)),std::istreambuf_iterator<char>());
+    const char *p=text.data(),*end=p+text.size();
+    if(text.size()>=3&&(unsigned char)p[0]==0xEF&&(unsigned char)p[1]==0xBB&&(unsigned char)p[2]==0xBF) p+=3;
+    const char *fb[5],*fe[5];
+    while(p<end){
+        const char *le=(const char*)std::memchr(p,'\n',end-p); if(!le) le=end;
+        const char *line=p; p=le+1;
+        if(le>line&&le[-1]=='\r') le--;
+        if(le==line||*line=='#') continue;
+        int fields=0; bool alpha=false;
+        for(const char *q=line;q<=le;){
+            const char *c=q; while(c<le&&*c!=',') c++;
+            if(fields<5){
+                const char *a=q,*z=c; while(a<z&&isBlank(*a)) a++; while(z>a&&isBlank(z[-1])) z--;
+                fb[fields]=a; fe[fields]=z;
+            }
+            for(const char *k=q;k<c;k++) if(std::isalpha((unsigned char)*k)){ alpha=true; break; }
+            fields++; q=c+1;
+        }
+        if(fields<5||alpha) continue;
+        Row r; double x[4]; bool ok=parseLeadingInt(fb[0],fe[0],r.frame);
+        for(int k=0;k<4&&ok;k++) ok=parseLeadingDouble(fb[k+1],fe[k+1],x[k]);
+        if(!ok) continue;
+        r.frame+=frameOffset; r.box.x1=x[0]; r.box.y1=x[1]; r.box.x2=x[2]; r.box.y2=x[3];
+        rows.push_back(r);
+    }
+    return true;
+}
+
+bool loadFrameBoxes(const std::string &path,int frameOffset,FrameBoxes &out,std::string *error){
+    std::vector<Row> rows;
+    if(DetectionReader::isDetectionFile(path)){
+        DetectionReader reader; if(!reader.open(path,error)) return false;
+        rows.resize(reader.size());
+        const DetRecord *r=reader.records();
+        for(size_t i=0;i<rows.size();i++){ rows[i].frame=r[i].frame+frameOffset; rows[i].box=EvalBox{r[i].x1,r[i].y1,r[i].x2,r[i].y2}; }
+    }else if(!loadCsv(path,frameOffset,rows,error)) return false;
+    return buildFrameBoxes(rows,out,error,path);
+}
+
+static inline double iou(const EvalBox &a,const EvalBox &b){
+    const double x1=std::max(a.x1,b.x1),y1=std::max(a.y1,b.y1),x2=std::min(a.x2,b.x2),y2=std::min(a.y2,b.y2);
+    const double inter=std::max(0.0,x2-x1)*std::max(0.0,y2-y1);
+    const double a1=std::max(0.0,a.x2-a.x1)*std::max(0.0,a.y2-a.y1), a2=std::max(0.0,b.x2-b.x1)*std::max(0.0,b.y2-b.y1);
+    const double uni=a1+a2-inter;
+    return uni>0?inter/uni:0.0;
+}
+
+static void matchFrame(const EvalBox *P,int np,const EvalBox *G,int ng,const std::vector<double> &thr,
+                       std::vector<double> &m,std::vector<char> &used,EvalCounts *acc){
+    if(ng==0||np==0){ for(size_t t=0;t<thr.size();t++){ acc[t].fp+=np; acc[t].fn+=ng; } return; }
+    m.resize((size_t)np*ng);
+    for(int i=0;i<np;i++) for(int j=0;j<ng;j++) m[(size_t)i*ng+j]=iou(P[i],G[j]);
+    for(size_t t=0;t<thr.size();t++){
+        used.assign(ng,0); EvalCounts &c=acc[t];
+        for(int i=0;i<np;i++){
+            const double *row=&m[(size_t)i*ng]; double best=0.0; int bj=-1;
+            for(int j=0;j<ng;j++) if(!used[j]&&row[j]>best){ best=row[j]; bj=j; }
+            if(bj>=0&&best>=thr[t]){ c.tp++; used[bj]=1; c.iouSum+=best; } else c.fp++;
+        }
+        for(int j=0;j<ng;j++) if(!used[j]) c.fn++;
+    }
+}
+
+std::vector<EvalCounts> evaluate(const FrameBoxes &pred,const FrameBoxes &gt,const std::vector<double> &thresholds,int threads){
+    const size_t T=thresholds.size();
+    std::vector<EvalCounts> total(T);
+    bool hp=pred.frameCount()>0,hg=gt.frameCount()>0;
+    if(!hp&&!hg) return total;
+    int lo=hp&&hg?std::min(pred.firstFrame,gt.firstFrame):hp?pred.firstFrame:gt.firstFrame;
+    int hi=std::max(hp?pred.firstFrame+pred.frameCount():INT_MIN,hg?gt.firstFrame+gt.frameCount():INT_MIN);
+    int chunks=(int)(((long)hi-lo+CHUNK_FRAMES-1)/CHUNK_FRAMES);
+    std::vector<EvalCounts> partial((size_t)chunks*T);
+    if(threads<=0) threads=(int)std::max(1u,std::thread::hardware_concurrency());
+    threads=std::max(1,std::min(threads,chunks));
+    std::atomic<int> next(0);
+    auto work=[&]{
+        std::vector<double> m; std::vector<char> used;
+        for(int c=next++;c<chunks;c=next++){
+            EvalCounts *acc=&partial[(size_t)c*T];
+            int f0=lo+c*CHUNK_FRAMES, f1=(int)std::min<long>((long)f0+CHUNK_FRAMES,hi);
+            for(int f=f0;f<f1;f++){
+                int pi=f-pred.firstFrame, gi=f-gt.firstFrame;
+                bool inP=pi>=0&&pi<pred.frameCount(), inG=gi>=0&&gi<gt.frameCount();
+                matchFrame(inP?pred.begin(pi):nullptr,inP?pred.count(pi):0,inG?gt.begin(gi):nullptr,inG?gt.count(gi):0,thresholds,m,used,acc);
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for(int w=1;w<threads;w++) pool.emplace_back(work);
+    work();
+    for(size_t i=0;i<pool.size();i++) pool[i].join();
+    for(int c=0;c<chunks;c++) for(size_t t=0;t<T;t++){
+        const EvalCounts &p=partial[(size_t)c*T+t]; EvalCounts &s=total[t];
+        s.tp+=p.tp; s.fp+=p.fp; s.fn+=p.fn; s.iouSum+=p.iouSum;
+    }
+    return total;
+}
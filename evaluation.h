@@ -0,0 +1,52 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#ifndef EVALUATION_H
+#define EVALUATION_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Detections of a whole video in two flat arrays: the boxes of frame firstFrame+i are
+// boxes[start[i]] .. boxes[start[i+1]-1], in file order. Frames without boxes cost one offset.
+struct EvalBox{ double x1,y1,x2,y2; };
+struct FrameBoxes{
+    int firstFrame=0; std::vector<uint32_t> start; std::vector<EvalBox> boxes;
+    int frameCount() const { return start.empty()?0:(int)start.size()-1; }
+    const EvalBox *begin(int i) const { return boxes.data()+start[i]; }
+    int count(int i) const { return (int)(start[i+1]-start[i]); }
+    // Frames [first,last) only, e.g. the part of a reference covered by a partial run.
+    FrameBoxes slice(int first,int last) const;
+    // Appends the next frame (firstFrame + frameCount()).
+    void appendFrame(const EvalBox *b,int n){ if(start.empty()) start.push_back(0); boxes.insert(boxes.end(),b,b+n); start.push_back((uint32_t)boxes.size()); }
+};
+
+// CSV (frame,x1,y1,x2,y2[,...]) or binary detection file (detfile.h), told apart by the header.
+// frameOffset is added to every frame number. CSV rows that are blank, start with '#', have fewer
+// than five fields or contain letters (headers) are skipped, as are rows with unparsable numbers.
+bool loadFrameBoxes(const std::string &path,int frameOffset,FrameBoxes &out,std::string *error=nullptr);
+
+// Leading number of the text field [b,e), like std::stoi / std::strtod: optional sign, at least one
+// digit, anything after the number ignored. No locale, no allocation; shared by the text loaders.
+bool parseLeadingInt(const char *b,const char *e,int &v);
+bool parseLeadingDouble(const char *b,const char *e,double &v);
+
+struct EvalCounts{
+    long tp=0,fp=0,fn=0; double iouSum=0;
+    double precision() const { return tp+fp?double(tp)/(tp+fp):0.0; }
+    double recall() const { return tp+fn?double(tp)/(tp+fn):0.0; }
+    double f1() const { double p=precision(),r=recall(); return p+r>0?2*p*r/(p+r):0.0; }
+    double meanIou() const { return tp?iouSum/tp:0.0; }
+};
+
+// Greedy matching per frame: every prediction, in order, takes the unused ground-truth box with the
+// highest IoU and is a true positive when that IoU reaches the threshold. The IoU matrix of a frame
+// is computed once and reused for every threshold. Frames are split over `threads` workers (all
+// cores when 0); the reduction order is fixed, so results do not depend on the thread count.
+std::vector<EvalCounts> evaluate(const FrameBoxes &pred,const FrameBoxes &gt,const std::vector<double> &thresholds,int threads=0);
+#endif
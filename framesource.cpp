@@ -0,0 +1,183 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#include "framesource.h"
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+#if defined(__unix__)||defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FRAMECACHE_MMAP 1
+#endif
+namespace fs=std::filesystem;
+
+static const char MAGIC[8]={'S','V','A','F','R','M','\0','\0'};
+static const uint32_t VERSION=1;
+static const uint64_t PAGE=4096;
+
+static uint64_t pageAlign(uint64_t v){ return (v+PAGE-1)/PAGE*PAGE; }
+
+// Source identity (canonical path, size, mtime) and the cache file named after it.
+static bool cacheIdentity(const std::string &video,const std::string &dir,FrameCacheHeader &id,std::string &cachePath){
+    std::error_code ec;
+    fs::path p=fs::weakly_canonical(fs::path(video),ec); if(ec) return false;
+    uint64_t size=fs::file_size(p,ec); if(ec) return false;
+    fs::file_time_type mtime=fs::last_write_time(p,ec); if(ec) return false;
+    std::string ps=p.string(); if(ps.size()>=sizeof(id.sourcePath)) return false;
+    std::memset(&id,0,sizeof(id));
+    std::memcpy(id.magic,MAGIC,sizeof(MAGIC)); id.version=VERSION; id.headerBytes=(uint32_t)PAGE;
+    id.sourceSize=size; id.sourceMtime=(int64_t)mtime.time_since_epoch().count();
+    std::memcpy(id.sourcePath,ps.c_str(),ps.size()+1);
+    uint64_t h=1469598103934665603ULL; // FNV-1a over path, size and mtime
+    auto mix=[&h](const void *d,size_t n){ const unsigned char *b=(const unsigned char*)d; for(size_t i=0;i<n;i++){ h^=b[i]; h*=1099511628211ULL; } };
+    mix(ps.data(),ps.size()); mix(&id.sourceSize,sizeof(id.sourceSize)); mix(&id.sourceMtime,sizeof(id.sourceMtime));
+    char hex[17]; std::snprintf(hex,sizeof(hex),"%016llx",(unsigned long long)h);
+    cachePath=(fs::path(dir)/(p.stem().string()+"-"+hex+".frames")).string();
+    return true;
+}
+
+VideoFrameSource::~VideoFrameSource(){ if(caching) abortCache(); }
+
+bool VideoFrameSource::open(const std::string &path,int first,int lastFrame){
+    if(!cap.open(path)) return false;
+    rate=cap.get(cv::CAP_PROP_FPS);
+    size=cv::Size((int)cap.get(cv::CAP_PROP_FRAME_WIDTH),(int)cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+    if(first>0) cap.set(cv::CAP_PROP_POS_FRAMES,first);
+    next=std::max(0,first); last=lastFrame;
+    return true;
+}
+
+void VideoFrameSource::teeToCache(const std::string &path,const FrameCacheHeader &hdr){
+    if(next!=0||last>=0) return; // only a full decode makes a complete cache
+    std::error_code ec; fs::create_directories(fs::path(path).parent_path(),ec);
+    cachePath=path; cacheTmp=path+".tmp"; cacheHdr=hdr;
+    cacheOut.open(cacheTmp,std::ios::binary|std::ios::trunc);
+    if(!cacheOut){ std::cerr<<"Warning: cannot write frame cache "<<cacheTmp<<"\n"; return; }
+    pad.assign(PAGE,0); cacheOut.write(pad.data(),PAGE); // header written once the frames are known
+    caching=true;
+}
+
+void VideoFrameSource::abortCache(){
+    caching=false; cacheOut.close();
+    std::error_code ec; fs::remove(cacheTmp,ec);
+}
+
+bool VideoFrameSource::read(cv::Mat &frame){
+    if(last>=0&&next>=last) return false;
+    if(!cap.read(frame)){
+        if(caching){
+            // End of the video: the cache is complete.
+            cacheHdr.frameCount=(uint64_t)next; caching=false;
+            cacheOut.seekp(0); cacheOut.write((const char*)&cacheHdr,sizeof(cacheHdr)); cacheOut.close();
+            std::error_code ec;
+            if(cacheOut.fail()||(fs::rename(cacheTmp,cachePath,ec),ec)){ fs::remove(cacheTmp,ec); std::cerr<<"Warning: could not finish frame cache "<<cachePath<<"\n"; }
+        }
+        return false;
+    }
+    if(caching){
+        uint64_t bytes=(uint64_t)frame.total()*frame.elemSize();
+        if(next==0){ cacheHdr.width=frame.cols; cacheHdr.height=frame.rows; cacheHdr.type=frame.type(); cacheHdr.fps=rate; cacheHdr.frameStride=pageAlign(bytes); }
+        if(!frame.isContinuous()||frame.cols!=cacheHdr.width||frame.rows!=cacheHdr.height||frame.type()!=cacheHdr.type) abortCache();
+        else{
+            cacheOut.write((const char*)frame.data,(std::streamsize)bytes);
+            cacheOut.write(pad.data(),(std::streamsize)(cacheHdr.frameStride-bytes));
+            if(!cacheOut){ std::cerr<<"Warning: frame cache write failed, disk full?\n"; abortCache(); }
+        }
+    }
+    next++;
+    return true;
+}
+
+CachedFrameSource::~CachedFrameSource(){
+#ifdef FRAMECACHE_MMAP
+    if(base) munmap(base,length);
+#endif
+}
+
+bool CachedFrameSource::open(const std::string &path,const FrameCacheHeader &expected,int firstFrame,int lastFrame,std::string *error){
+#ifdef FRAMECACHE_MMAP
+    auto fail=[&](const std::string &why){ if(base){ munmap(base,length); base=nullptr; } if(error) *error=path+": "+why; return false; };
+    int fd=::open(path.c_str(),O_RDONLY); if(fd<0) return fail("cannot open");
+    struct stat st; if(fstat(fd,&st)!=0||(size_t)st.st_size<PAGE){ ::close(fd); return fail("too short"); }
+    length=(size_t)st.st_size;
+    // Private and writable: callers may draw on the frames, the file itself never changes.
+    void *p=mmap(nullptr,length,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+    ::close(fd);
+    if(p==MAP_FAILED) return fail("cannot map");
+    base=(unsigned char*)p;
+    std::memcpy(&hdr,base,sizeof(hdr));
+    if(std::memcmp(hdr.magic,MAGIC,sizeof(MAGIC))!=0||hdr.version!=VERSION) return fail("not a frame cache");
+    if(std::strncmp(hdr.sourcePath,expected.sourcePath,sizeof(hdr.sourcePath))!=0||hdr.sourceSize!=expected.sourceSize||hdr.sourceMtime!=expected.sourceMtime)
+        return fail("made from a different version of the video");
+    uint64_t frameBytes=(uint64_t)hdr.width*hdr.height*CV_ELEM_SIZE(hdr.type);
+    if(hdr.width<=0||hdr.height<=0||hdr.frameStride<frameBytes||hdr.frameStride%PAGE||hdr.headerBytes%PAGE||
+       hdr.headerBytes+hdr.frameCount*hdr.frameStride>length) return fail("truncated");
+    first=std::min(std::max(0,firstFrame),(int)hdr.frameCount); next=first;
+    last=lastFrame<0?(int)hdr.frameCount:std::max(first,std::min(lastFrame,(int)hdr.frameCount));
+    madvise(base,length,MADV_SEQUENTIAL);
+    return true;
+#else
+    (void)expected; (void)firstFrame; (void)lastFrame;
+    if(error) *error=path+": frame cache needs mmap";
+    return false;
+#endif
+}
+
+bool CachedFrameSource::read(cv::Mat &frame){
+    if(next>=last) return false;
+    frame=cv::Mat(hdr.height,hdr.width,hdr.type,base+hdr.headerBytes+(uint64_t)next*hdr.frameStride);
+#ifdef FRAMECACHE_MMAP
+    // Frames the caller is done with go back to the file contents, dropping any pages drawn on.
+    int old=next-inFlight;
+    if(old>=first) madvise(base+hdr.headerBytes+(uint64_t)old*hdr.frameStride,hdr.frameStride,MADV_DONTNEED);
+#endif
+    next++;
+    return true;
+}
+
+std::unique_ptr<FrameSource> openFrameSource(const std::string &path,const FrameSourceOptions &opt,std::string *error){
+    FrameCacheHeader id; std::string cachePath; bool useCache=false;
+    if(!opt.cacheDir.empty()){
+        useCache=cacheIdentity(path,opt.cacheDir,id,cachePath);
+        std::error_code ec;
+        if(useCache&&fs::exists(cachePath,ec)){
+            std::unique_ptr<CachedFrameSource> c(new CachedFrameSource); std::string why;
+            if(c->open(cachePath,id,opt.first,opt.last,&why)) return c;
+            std::cerr<<"Warning: ignoring frame cache ("<<why<<")\n";
+        }
+    }
+    std::unique_ptr<VideoFrameSource> v(new VideoFrameSource);
+    if(!v->open(path,opt.first,opt.last)){ if(error) *error="could not open "+path; return nullptr; }
+    if(useCache) v->teeToCache(cachePath,id);
+    return v;
+}
+
+// One side of a frame range: empty (def) or a whole non-negative number.
+static bool parseFrameBound(const std::string &s,int def,int &v){
+    if(s.empty()){ v=def; return true; }
+    char *end=nullptr; errno=0; long n=std::strtol(s.c_str(),&end,10);
+    if(*end||errno||n<0||n>INT_MAX||!std::isdigit((unsigned char)s[0])) return false;
+    v=(int)n; return true;
+}
+
+bool parseFrameRange(const std::string &spec,int &first,int &last){
+    size_t c=spec.find(':');
+    std::string a=c==std::string::npos?std::string():spec.substr(0,c), b=c==std::string::npos?spec:spec.substr(c+1);
+    if(c==std::string::npos&&b.empty()) return false;
+    if(!parseFrameBound(a,0,first)||!parseFrameBound(b,-1,last)) return false;
+    return last<0||last>first;
+}
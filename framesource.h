@@ -0,0 +1,82 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Where frames come from: the video codec, or a decoded-frame cache from an earlier run.
+class FrameSource{
+public:
+    virtual ~FrameSource(){}
+    // Next frame of the range; false at its end. The frame may alias source memory (see CachedFrameSource).
+    virtual bool read(cv::Mat &frame)=0;
+    virtual int nextIndex() const=0;        // video frame number the next read() returns
+    virtual double fps() const=0;
+    virtual cv::Size frameSize() const=0;
+    // How many recently returned frames the caller may still be using (pipeline depth); default 2.
+    virtual void setInFlight(int frames){ (void)frames; }
+};
+
+// Frame range [first,last) of the video (last < 0: to the end) and the cache directory ("" = no cache).
+struct FrameSourceOptions{ std::string cacheDir; int first=0,last=-1; };
+// --frames value: "first:last" with either side optional, or a plain "n" for 0:n; each side a whole
+// non-negative number. last is exclusive, -1 the end.
+bool parseFrameRange(const std::string &spec,int &first,int &last);
+
+// Decoded-frame cache file: a page-sized header, then every frame as raw interleaved pixels at a
+// page-aligned stride, so frames can be mapped and wrapped in a cv::Mat without copying.
+// The header records the source path, size and modification time; a cache that does not match the
+// video on disk is ignored and rebuilt.
+struct FrameCacheHeader{
+    char magic[8]; uint32_t version,headerBytes; int32_t width,height,type,reserved;
+    uint64_t frameCount,frameStride,sourceSize; int64_t sourceMtime; double fps; char sourcePath[1024];
+};
+
+class VideoFrameSource: public FrameSource{
+    cv::VideoCapture cap; int next=0,last=-1; double rate=0; cv::Size size;
+    std::ofstream cacheOut; std::string cachePath,cacheTmp; FrameCacheHeader cacheHdr; bool caching=false;
+    std::vector<char> pad;
+    void abortCache();
+public:
+    ~VideoFrameSource();
+    bool open(const std::string &path,int first,int last);
+    // Also writes every decoded frame to cachePath (through a temporary file, renamed when the
+    // video has been read to its end). hdr carries the source identity.
+    void teeToCache(const std::string &path,const FrameCacheHeader &hdr);
+    bool read(cv::Mat &frame) override;
+    int nextIndex() const override { return next; }
+    double fps() const override { return rate; }
+    cv::Size frameSize() const override { return size; }
+};
+
+// Reads a cache file through a private writable mapping: frames are returned without copying,
+// and drawing on them (annotations) only touches private copies of the pages. Those copies are
+// dropped again once a frame is more than setInFlight() reads old, so memory stays bounded.
+class CachedFrameSource: public FrameSource{
+    unsigned char *base=nullptr; size_t length=0; FrameCacheHeader hdr; int first=0,next=0,last=0,inFlight=2;
+public:
+    ~CachedFrameSource();
+    bool open(const std::string &path,const FrameCacheHeader &expected,int first,int last,std::string *error);
+    bool read(cv::Mat &frame) override;
+    int nextIndex() const override { return next; }
+    double fps() const override { return hdr.fps; }
+    cv::Size frameSize() const override { return cv::Size(hdr.width,hdr.height); }
+    void setInFlight(int frames) override { inFlight=std::max(1,frames); }
+    int frameCount() const { return (int)hdr.frameCount; }
+};
+
+// Cached frames when a valid cache exists, otherwise the codec (filling the cache on a full read).
+std::unique_ptr<FrameSource> openFrameSource(const std::string &path,const FrameSourceOptions &opt,std::string *error=nullptr);
+#endif
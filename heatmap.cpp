@@ -7,30 +7,229 @@
          No external source code beyond standard libraries and OpenCV.
 ********************************************************************************/
 #include "heatmap.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
 
-Heatmap::Heatmap(){ colors.push_back(cv::Scalar(0,0,255)); colors.push_back(cv::Scalar(255,0,0)); colors.push_back(cv::Scalar(0,255,0)); }
+static const int RADIUS=20;
 
-void Heatmap::update(const cv::Mat &frame,const std::vector<std::pair<cv::Rect,int> > &classified){
-    if(accum.empty()){ accum=cv::Mat::zeros(frame.size(),CV_32FC3); first=frame.clone(); }
+Heatmap::Heatmap(){
+    colors.push_back(cv::Scalar(0,0,255)); colors.push_back(cv::Scalar(255,0,0)); colors.push_back(cv::Scalar(0,255,0));
+    // One filled disc rendered once; update() adds it around each player instead of drawing a
+    // circle into a full-frame image. Drawing with an integer centre is translation invariant,
+    // so the splat covers exactly the pixels the per-player circle did.
+    stamp=cv::Mat::zeros(2*RADIUS+3,2*RADIUS+3,CV_32FC1);
+    cv::circle(stamp,cv::Point(RADIUS+1,RADIUS+1),RADIUS,cv::Scalar(255),-1,cv::LINE_AA);
+}
+
+void Heatmap::update(const cv::Mat &frame,const std::vector<ClassifiedPlayer> &classified,std::vector<HeatSplat> *log){
+    if(teamAccum.empty()){
+        for(size_t t=0;t<colors.size();t++) teamAccum.push_back(cv::Mat::zeros(frame.size(),CV_32FC1));
+        first=frame.clone();
+    }
     for(size_t i=0;i<classified.size();i++){
-        cv::Mat t=cv::Mat::zeros(frame.size(),CV_32FC3);
-        int team=classified[i].second;
-        if(team<0||team>=(int)colors.size()) team=2; // Unknown -> green
-        cv::Point c=(classified[i].first.tl()+classified[i].first.br())*0.5;
-        cv::circle(t,c,20,colors[team],-1,cv::LINE_AA);
-        accum+=t;
+        HeatSplat s; s.team=classified[i].team;
+        if(s.team<0||s.team>=(int)colors.size()) s.team=2; // Unknown -> green
+        s.centre=(classified[i].box.tl()+classified[i].box.br())*0.5;
+        stampAt(s,true);
+        if(log) log->push_back(s);
     }
 }
 
-void Heatmap::saveAndShow(){
-    if(accum.empty()) return;
-    cv::Mat blr,hm8,ov;
+void Heatmap::subtract(const std::vector<HeatSplat> &splats){
+    if(teamAccum.empty()) return;
+    for(size_t i=0;i<splats.size();i++) stampAt(splats[i],false);
+}
+
+void Heatmap::stampAt(const HeatSplat &s,bool add){
+    cv::Point o(s.centre.x-RADIUS-1,s.centre.y-RADIUS-1);
+    cv::Rect dst=cv::Rect(o.x,o.y,stamp.cols,stamp.rows)&cv::Rect(0,0,teamAccum[0].cols,teamAccum[0].rows);
+    if(dst.area()<=0) return;
+    cv::Mat roi=teamAccum[s.team](dst), src=stamp(cv::Rect(dst.x-o.x,dst.y-o.y,dst.width,dst.height));
+    if(add) roi+=src; else roi-=src; // integer-valued sums, so subtraction is exact
+}
+
+cv::Mat Heatmap::accumulated() const {
+    if(teamAccum.empty()) return cv::Mat();
+    std::vector<cv::Mat> planes(3);
+    for(int ch=0;ch<3;ch++){
+        planes[ch]=cv::Mat::zeros(teamAccum[0].size(),CV_32FC1);
+        for(size_t t=0;t<colors.size();t++) if(colors[t][ch]!=0) cv::scaleAdd(teamAccum[t],colors[t][ch]/255.0,planes[ch],planes[ch]);
+    }
+    cv::Mat out; cv::merge(planes,out); return out;
+}
+
+void Heatmap::render(const cv::Mat &accum,const cv::Mat &background,cv::Mat &hm8,cv::Mat &overlay){
+    cv::Mat blr;
     cv::GaussianBlur(accum,blr,cv::Size(0,0),15);
     cv::normalize(blr,blr,0,255,cv::NORM_MINMAX);
     blr.convertTo(hm8,CV_8UC3);
-    cv::addWeighted(first,0.5,hm8,0.5,0,ov);
-    cv::imshow("Combined Heatmap",hm8);
-    cv::imshow("Heatmap Overlay",ov);
-    cv::imwrite("combined_heatmap.png",hm8);
-    cv::imwrite("heatmap_overlay.png",ov);
+    cv::addWeighted(background,0.5,hm8,0.5,0,overlay);
+}
+
+void Heatmap::saveAndShow(bool display,const std::string &outDir){
+    if(teamAccum.empty()) return;
+    cv::Mat hm8,ov;
+    render(accumulated(),first,hm8,ov);
+    if(display){
+        cv::imshow("Combined Heatmap",hm8);
+        cv::imshow("Heatmap Overlay",ov);
+    }
+    std::string prefix=outDir.empty()?std::string():outDir+"/";
+    cv::imwrite(prefix+"combined_heatmap.png",hm8);
+    cv::imwrite(prefix+"heatmap_overlay.png",ov);
+}
+
+RollingHeatmap::RollingHeatmap(const RollingConfig &c,const std::string &outDir):cfg(c),dir(outDir),queue(2){
+    cfg.intervalFrames=std::max(1,cfg.intervalFrames); cfg.windowIntervals=std::max(1,cfg.windowIntervals);
+    if(!dir.empty()) std::filesystem::create_directories(dir);
+    writer=std::thread([this]{
+        Snapshot s; double stall=0; cv::Mat hm8,ov;
+        std::string prefix=dir.empty()?std::string():dir+"/";
+        while(queue.pop(s,stall)){
+            Heatmap::render(s.accum,s.background,hm8,ov);
+            std::string tag=std::to_string(s.endFrame);
+            cv::imwrite(prefix+"heatmap_"+tag+".png",hm8);
+            cv::imwrite(prefix+"overlay_"+tag+".png",ov);
+            written++;
+        }
+    });
+}
+
+RollingHeatmap::~RollingHeatmap(){ finish(); }
+
+void RollingHeatmap::update(const cv::Mat &frame,const std::vector<ClassifiedPlayer> &classified){
+    window.update(frame,classified,&current);
+    frames++;
+    if(++inInterval>=cfg.intervalFrames) closeInterval(frame,false);
+}
+
+void RollingHeatmap::closeInterval(const cv::Mat &background,bool wait){
+    intervals.push_back(std::move(current)); current.clear(); inInterval=0;
+    while((int)intervals.size()>cfg.windowIntervals){ window.subtract(intervals.front()); intervals.pop_front(); }
+    Snapshot s; s.endFrame=frames-1; s.accum=window.accumulated();
+    lastBackground=background.clone(); s.background=lastBackground;
+    double stall=0;
+    bool queued=!s.accum.empty()&&(wait?queue.push(std::move(s),stall):queue.tryPush(std::move(s)));
+    if(!queued) dropped++;
+}
+
+void RollingHeatmap::finish(){
+    if(finished) return;
+    finished=true;
+    if(inInterval>0) closeInterval(lastBackground.empty()?window.firstFrame():lastBackground,true);
+    queue.close(); writer.join();
+}
+
+PitchHeatmap::PitchHeatmap(const PitchConfig &c):cfg(c){
+    colors.push_back(cv::Scalar(0,0,255)); colors.push_back(cv::Scalar(255,0,0)); colors.push_back(cv::Scalar(0,255,0));
+    int cols=std::max(1,(int)std::lround(cfg.lengthM*cfg.cellsPerMetre)), rows=std::max(1,(int)std::lround(cfg.widthM*cfg.cellsPerMetre));
+    for(size_t t=0;t<colors.size();t++) grids.push_back(cv::Mat::zeros(rows,cols,CV_32FC1));
+}
+
+void PitchHeatmap::update(const cv::Mat &H,const std::vector<ClassifiedPlayer> &classified){
+    if(H.empty()) return;
+    const cv::Matx33d h=H;
+    for(size_t i=0;i<classified.size();i++){
+        const cv::Rect &b=classified[i].box;
+        double x=b.x+b.width*0.5, y=b.y+b.height;
+        double w=h(2,0)*x+h(2,1)*y+h(2,2); if(std::fabs(w)<1e-12) continue;
+        double px=(h(0,0)*x+h(0,1)*y+h(0,2))/w, py=(h(1,0)*x+h(1,1)*y+h(1,2))/w;
+        int c=(int)std::floor(px*cfg.cellsPerMetre), r=(int)std::floor(py*cfg.cellsPerMetre);
+        if(c<0||r<0||c>=grids[0].cols||r>=grids[0].rows) continue; // off the pitch
+        int team=classified[i].team;
+        if(team<0||team>=(int)colors.size()) team=2;
+        grids[team].at<float>(r,c)+=1.f;
+    }
+}
+
+bool PitchHeatmap::merge(const std::vector<cv::Mat> &other){
+    if(other.size()!=grids.size()) return false;
+    for(size_t t=0;t<grids.size();t++) if(other[t].size()!=grids[t].size()||other[t].type()!=CV_32FC1) return false;
+    for(size_t t=0;t<grids.size();t++) grids[t]+=other[t];
+    return true;
+}
+
+bool PitchHeatmap::saveGrids(const std::string &path) const {
+    cv::FileStorage fs(path,cv::FileStorage::WRITE); if(!fs.isOpened()) return false;
+    fs<<"length_m"<<cfg.lengthM<<"width_m"<<cfg.widthM<<"cells_per_metre"<<cfg.cellsPerMetre;
+    fs<<"team0"<<grids[0]<<"team1"<<grids[1]<<"unknown"<<grids[2];
+    return true;
+}
+
+bool PitchHeatmap::loadGrids(const std::string &path){
+    cv::FileStorage fs(path,cv::FileStorage::READ); if(!fs.isOpened()) return false;
+    PitchConfig c; fs["length_m"]>>c.lengthM; fs["width_m"]>>c.widthM; fs["cells_per_metre"]>>c.cellsPerMetre;
+    std::vector<cv::Mat> g(3); fs["team0"]>>g[0]; fs["team1"]>>g[1]; fs["unknown"]>>g[2];
+    if(c.cellsPerMetre<=0) return false;
+    PitchHeatmap loaded(c);
+    if(!loaded.merge(g)) return false;
+    *this=loaded; return true;
+}
+
+void PitchHeatmap::saveAndShow(bool display,const std::string &outDir) const {
+    // Counts are spread over ~1.5 m, then coloured per team like the image-space heatmap.
+    double sigma=1.5*cfg.cellsPerMetre;
+    std::vector<cv::Mat> planes(3);
+    for(int ch=0;ch<3;ch++) planes[ch]=cv::Mat::zeros(grids[0].size(),CV_32FC1);
+    cv::Mat blr;
+    for(size_t t=0;t<grids.size();t++){
+        cv::GaussianBlur(grids[t],blr,cv::Size(0,0),sigma);
+        for(int ch=0;ch<3;ch++) if(colors[t][ch]!=0) cv::scaleAdd(blr,colors[t][ch]/255.0,planes[ch],planes[ch]);
+    }
+    cv::Mat acc,hm8; cv::merge(planes,acc);
+    cv::normalize(acc,acc,0,255,cv::NORM_MINMAX);
+    acc.convertTo(hm8,CV_8UC3);
+    // Upscale to roughly 840 px wide and draw the standard markings on top.
+    double s=std::max(1.0,std::floor(840.0/hm8.cols)), m=s*cfg.cellsPerMetre;
+    cv::Mat img; cv::resize(hm8,img,cv::Size(),s,s,cv::INTER_LINEAR);
+    const cv::Scalar line(255,255,255); double L=cfg.lengthM, W=cfg.widthM;
+    auto P=[&](double x,double y){ return cv::Point((int)std::lround(x*m),(int)std::lround(y*m)); };
+    cv::rectangle(img,P(0,0),P(L,W)-cv::Point(1,1),line,1);
+    cv::line(img,P(L/2,0),P(L/2,W),line,1);
+    cv::circle(img,P(L/2,W/2),(int)std::lround(9.15*m),line,1,cv::LINE_AA);
+    cv::rectangle(img,P(0,W/2-20.16),P(16.5,W/2+20.16),line,1);
+    cv::rectangle(img,P(L-16.5,W/2-20.16),P(L,W/2+20.16),line,1);
+    if(display) cv::imshow("Pitch Heatmap",img);
+    std::string prefix=outDir.empty()?std::string():outDir+"/";
+    cv::imwrite(prefix+"pitch_heatmap.png",img);
+    saveGrids(prefix+"pitch_grid.yml");
+}
+
+bool PitchHeatmap::loadHomography(const std::string &path,cv::Mat &H){
+    cv::FileStorage fs(path,cv::FileStorage::READ); if(!fs.isOpened()) return false;
+    cv::Mat h; fs["homography"]>>h;
+    if(h.rows!=3||h.cols!=3) return false;
+    h.convertTo(H,CV_64F); return true;
+}
+
+bool PitchHeatmap::estimateHomography(const cv::Mat &fieldMask,double toFull,const PitchConfig &c,cv::Mat &H){
+    if(fieldMask.empty()) return false;
+    cv::Mat tmp=fieldMask.clone();
+    std::vector<std::vector<cv::Point> > contours; cv::findContours(tmp,contours,cv::RETR_EXTERNAL,cv::CHAIN_APPROX_SIMPLE);
+    int best=-1; double bestArea=0;
+    for(size_t i=0;i<contours.size();i++){ double a=cv::contourArea(contours[i]); if(a>bestArea){ bestArea=a; best=(int)i; } }
+    if(best<0||bestArea<0.1*fieldMask.total()) return false;
+    std::vector<cv::Point> hull,quad; cv::convexHull(contours[best],hull);
+    double peri=cv::arcLength(hull,true);
+    for(double eps=0.01;eps<=0.1&&quad.size()!=4;eps+=0.01) cv::approxPolyDP(hull,quad,eps*peri,true);
+    std::vector<cv::Point2f> img(4);
+    if(quad.size()==4) for(int k=0;k<4;k++) img[k]=cv::Point2f(quad[k]);
+    else{ cv::Point2f r[4]; cv::minAreaRect(hull).points(r); img.assign(r,r+4); }
+    // Order as top-left, top-right, bottom-right, bottom-left: clockwise on screen around the
+    // centroid, starting from the corner with the smallest x+y.
+    cv::Point2f ctr(0,0); for(int k=0;k<4;k++) ctr+=img[k]*0.25f;
+    std::sort(img.begin(),img.end(),[&](const cv::Point2f &a,const cv::Point2f &b){ return std::atan2(a.y-ctr.y,a.x-ctr.x)<std::atan2(b.y-ctr.y,b.x-ctr.x); });
+    int first=0; for(int k=1;k<4;k++) if(img[k].x+img[k].y<img[first].x+img[first].y) first=k;
+    std::vector<cv::Point2f> ord(4);
+    for(int k=0;k<4;k++) ord[k]=img[(first+k)%4]*(float)toFull;
+    // A degenerate quad makes getPerspectiveTransform singular (an all-zero matrix passes checkRange).
+    for(int i=0;i<4;i++) for(int j=i+1;j<4;j++) if(cv::norm(ord[i]-ord[j])<1.0) return false;
+    if(!cv::isContourConvex(ord)||cv::contourArea(ord)<0.1*fieldMask.total()*toFull*toFull) return false;
+    std::vector<cv::Point2f> pitch={cv::Point2f(0,0),cv::Point2f((float)c.lengthM,0),cv::Point2f((float)c.lengthM,(float)c.widthM),cv::Point2f(0,(float)c.widthM)};
+    cv::Mat h=cv::getPerspectiveTransform(ord,pitch);
+    if(h.empty()||!cv::checkRange(h)) return false;
+    const double n=cv::norm(h,cv::NORM_INF);
+    if(std::fabs(cv::determinant(h))<=1e-9*n*n*n) return false;
+    H=h; return true;
 }
@@ -9,12 +9,83 @@
 #ifndef HEATMAP_H
 #define HEATMAP_H
 #include <opencv2/opencv.hpp>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <thread>
 #include <vector>
+#include "classification.h"
+#include "pipeline.h"
+// One disc added by Heatmap::update (box centre and team index after the unknown fallback).
+struct HeatSplat{ cv::Point centre; int team; };
+// Per-team single-channel accumulators at frame resolution; the team colours are only mixed in
+// when the heatmap is composed, so an update touches just a small window around each player.
 class Heatmap{
-    cv::Mat accum; cv::Mat first; std::vector<cv::Scalar> colors;
+    std::vector<cv::Mat> teamAccum; cv::Mat first,stamp; std::vector<cv::Scalar> colors;
 public:
     Heatmap();
-    void update(const cv::Mat &frame,const std::vector<std::pair<cv::Rect,int> > &classified);
-    void saveAndShow();
+    // When log is given the added discs are appended to it, so they can be subtracted later.
+    void update(const cv::Mat &frame,const std::vector<ClassifiedPlayer> &classified,std::vector<HeatSplat> *log=nullptr);
+    void subtract(const std::vector<HeatSplat> &splats);
+    // Colour composition of the team accumulators (CV_32FC3, team colours scaled by 1/255).
+    cv::Mat accumulated() const;
+    const cv::Mat &firstFrame() const { return first; }
+    // PNGs are written to outDir (current directory when empty).
+    void saveAndShow(bool display=true,const std::string &outDir="");
+    // Blur, normalisation and overlay shared by the final and the rolling heatmaps.
+    static void render(const cv::Mat &accum,const cv::Mat &background,cv::Mat &hm8,cv::Mat &overlay);
+private:
+    void stampAt(const HeatSplat &s,bool add);
+};
+
+// Sliding-window heatmap for live feeds. The window is a ring of windowIntervals intervals of
+// intervalFrames frames; each interval keeps only the discs it added, and when it falls out of the
+// window they are subtracted again, so memory stays bounded however long the match runs. At every
+// interval end a snapshot of the window is queued to a background thread that does the blur,
+// normalisation and PNG writing; if that thread falls behind the snapshot is dropped, never waited for.
+struct RollingConfig{ int intervalFrames=1500; int windowIntervals=5; };
+class RollingHeatmap{
+    struct Snapshot{ long endFrame=0; cv::Mat accum,background; };
+    RollingConfig cfg; std::string dir; Heatmap window;
+    std::deque<std::vector<HeatSplat> > intervals; std::vector<HeatSplat> current;
+    int inInterval=0; long frames=0; cv::Mat lastBackground;
+    BoundedQueue<Snapshot> queue; std::thread writer; bool finished=false;
+    std::atomic<long> written{0}; long dropped=0;
+    void closeInterval(const cv::Mat &background,bool wait);
+public:
+    // Snapshots go to outDir as heatmap_<last frame>.png and overlay_<last frame>.png.
+    RollingHeatmap(const RollingConfig &c,const std::string &outDir);
+    ~RollingHeatmap();
+    void update(const cv::Mat &frame,const std::vector<ClassifiedPlayer> &classified);
+    // Snapshots the unfinished interval and waits for the writer; the destructor calls it if needed.
+    void finish();
+    long snapshotsWritten() const { return written; }
+    long snapshotsDropped() const { return dropped; }
+};
+
+// Pitch-plane heatmap: each player's foot point (bottom centre of the box) goes through an
+// image -> pitch homography (pixels to metres) into a fixed grid of cellsPerMetre cells per metre.
+// Memory and per-frame cost do not depend on the video resolution, the map is not smeared by camera
+// pans, and grids of different matches add up with merge().
+struct PitchConfig{ double lengthM=105,widthM=68; int cellsPerMetre=2; };
+class PitchHeatmap{
+    PitchConfig cfg; std::vector<cv::Mat> grids; std::vector<cv::Scalar> colors;
+public:
+    explicit PitchHeatmap(const PitchConfig &c=PitchConfig());
+    const PitchConfig &config() const { return cfg; }
+    // Per-team occupancy counts (CV_32FC1, rows=width, cols=length); index 2 holds unknown players.
+    const std::vector<cv::Mat> &teamGrids() const { return grids; }
+    void update(const cv::Mat &H,const std::vector<ClassifiedPlayer> &classified);
+    // Adds another match; false when the grid sizes differ.
+    bool merge(const std::vector<cv::Mat> &other);
+    bool saveGrids(const std::string &path) const;
+    bool loadGrids(const std::string &path);
+    // Renders pitch_heatmap.png (with pitch markings) and saves pitch_grid.yml in outDir.
+    void saveAndShow(bool display=true,const std::string &outDir="") const;
+    // 3x3 image->pitch homography stored under "homography" in a YAML/XML file.
+    static bool loadHomography(const std::string &path,cv::Mat &H);
+    // Fits a quadrilateral to the largest field-mask region and maps it onto the pitch corners; only
+    // meaningful when the whole pitch is in view. toFull rescales mask coordinates to frame pixels.
+    static bool estimateHomography(const cv::Mat &fieldMask,double toFull,const PitchConfig &c,cv::Mat &H);
 };
 #endif
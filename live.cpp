@@ -0,0 +1,96 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#include "live.h"
+#include <algorithm>
+#include <iomanip>
+#include "profiler.h"
+
+static const double UP_RATIO=0.9;      // step up when the smoothed frame time passes 90% of the deadline...
+static const double DOWN_RATIO=0.5;    // ...and back down below 50%
+static const int UP_DWELL=5, DOWN_DWELL=50; // frames at a level before the next step up / down
+static const double SMOOTHING=0.2;
+
+LiveFeed::LiveFeed(FrameSource &source,bool pacedReplay):src(source),paced(pacedReplay),lastIdx(source.nextIndex()-1){
+    grabber=std::thread([this]{ run(); });
+}
+
+void LiveFeed::run(){
+    Profiler::setThreadName("capture");
+    const double fps=src.fps()>0?src.fps():25.0;
+    const std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+    cv::Mat buf,spare; long k=0;
+    for(;;){
+        int idx=src.nextIndex(); bool ok;
+        { PROFILE_SCOPE("decode"); ok=src.read(buf); }
+        if(!ok) break;
+        buf.copyTo(spare); // the source may reuse or unmap buf
+        std::unique_lock<std::mutex> lk(m);
+        if(paced) ready.wait_until(lk,t0+std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(k/fps)),[this]{ return stopping; });
+        k++;
+        if(stopping) break;
+        std::swap(slot,spare); slotIdx=idx; slotArrival=std::chrono::steady_clock::now(); fresh=true;
+        ready.notify_all();
+    }
+    std::lock_guard<std::mutex> lk(m);
+    done=true; ready.notify_all();
+}
+
+bool LiveFeed::next(cv::Mat &frame,int &idx,std::chrono::steady_clock::time_point &arrival,int &skipped){
+    std::unique_lock<std::mutex> lk(m);
+    ready.wait(lk,[this]{ return fresh||done; });
+    if(!fresh) return false;
+    std::swap(frame,slot); fresh=false;
+    idx=slotIdx; arrival=slotArrival; skipped=std::max(0,idx-lastIdx-1); lastIdx=idx;
+    return true;
+}
+
+void LiveFeed::stop(){
+    { std::lock_guard<std::mutex> lk(m); stopping=true; ready.notify_all(); }
+    if(grabber.joinable()) grabber.join();
+}
+
+const char *liveLevelName(int level){
+    static const char *names[LIVE_LEVELS]={"full","cached features","deferred heatmap","half scale"};
+    return level>=0&&level<LIVE_LEVELS?names[level]:"?";
+}
+
+int QualityController::update(double busyMs){
+    smoothed=smoothed<0?busyMs:(1-SMOOTHING)*smoothed+SMOOTHING*busyMs;
+    atLevel++;
+    if(lvl<maxLevel&&atLevel>=UP_DWELL&&smoothed>UP_RATIO*deadline){ lvl++; atLevel=0; }
+    else if(lvl>LIVE_FULL&&atLevel>=DOWN_DWELL&&smoothed<DOWN_RATIO*deadline){ lvl--; atLevel=0; }
+    return lvl;
+}
+
+void LiveMeter::frame(double latencyMs,int skipped,int level){
+    latencies.push_back((float)latencyMs);
+    st.frames++; st.dropped+=skipped; st.levelFrames[level]++;
+    if(latencyMs>st.deadlineMs) st.late++;
+}
+
+LiveStats LiveMeter::finish(){
+    if(latencies.empty()) return st;
+    double sum=0; for(float v:latencies) sum+=v;
+    st.meanMs=sum/latencies.size();
+    std::sort(latencies.begin(),latencies.end());
+    auto pct=[&](double p){ return (double)latencies[std::min(latencies.size()-1,(size_t)(p*latencies.size()))]; };
+    st.p50Ms=pct(0.50); st.p95Ms=pct(0.95); st.p99Ms=pct(0.99); st.maxMs=latencies.back();
+    return st;
+}
+
+void printLiveStats(std::ostream &os,const LiveStats &st){
+    std::ios::fmtflags flags=os.flags(); std::streamsize precision=os.precision();
+    os<<std::fixed<<std::setprecision(1)
+      <<"Live: "<<st.frames<<" frames processed, "<<st.dropped<<" dropped ("<<100.0*st.dropRate()<<"%)\n"
+      <<"  end-to-end latency ms: mean "<<st.meanMs<<"  p50 "<<st.p50Ms<<"  p95 "<<st.p95Ms<<"  p99 "<<st.p99Ms<<"  max "<<st.maxMs
+      <<"  (over the "<<st.deadlineMs<<" ms deadline: "<<st.late<<")\n  frames per level:";
+    for(int l=0;l<LIVE_LEVELS;l++) os<<"  "<<liveLevelName(l)<<" "<<st.levelFrames[l];
+    os<<"\n";
+    os.flags(flags); os.precision(precision);
+}
@@ -0,0 +1,69 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#ifndef LIVE_H
+#define LIVE_H
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+#include "framesource.h"
+
+// A FrameSource read the way a live camera delivers it: a capture thread reads ahead and keeps
+// only the newest frame, so a consumer that falls behind skips frames instead of lagging further.
+// With paced=true frame k is released k/fps seconds after the start, which replays a file at its
+// nominal rate; a camera or stream is read as fast as it produces frames.
+class LiveFeed{
+    FrameSource &src; bool paced;
+    std::mutex m; std::condition_variable ready; std::thread grabber;
+    cv::Mat slot; int slotIdx=-1,lastIdx; std::chrono::steady_clock::time_point slotArrival;
+    bool fresh=false,done=false,stopping=false;
+    void run();
+public:
+    LiveFeed(FrameSource &source,bool pacedReplay);
+    ~LiveFeed(){ stop(); }
+    // Waits for a frame newer than the last one returned; false once the source has ended.
+    // skipped is the number of frames that arrived in between and were dropped. The frame buffer
+    // is swapped with the caller's, so it stays valid until the next call.
+    bool next(cv::Mat &frame,int &idx,std::chrono::steady_clock::time_point &arrival,int &skipped);
+    void stop();
+};
+
+// Cumulative levels of per-frame work shed by live mode.
+enum LiveLevel{ LIVE_FULL, LIVE_CACHED_FEATURES, LIVE_DEFER_HEATMAP, LIVE_HALF_SCALE, LIVE_LEVELS };
+const char *liveLevelName(int level);
+
+// Steps the quality level up when the smoothed work time of a frame nears the deadline and back
+// down once there is clear slack. Stepping down waits longer than stepping up, so a level that only
+// just fits is not left after a few fast frames.
+class QualityController{
+    double deadline,smoothed=-1; int lvl=LIVE_FULL,atLevel=0,maxLevel;
+public:
+    explicit QualityController(double deadlineMs,int highestLevel=LIVE_LEVELS-1):deadline(deadlineMs),maxLevel(highestLevel){}
+    int update(double busyMs); // work time of the frame just done; returns the level for the next one
+    int level() const { return lvl; }
+};
+
+// End-to-end latency (frame arrival to output written) and drops of a live run.
+struct LiveStats{
+    long frames=0,dropped=0,late=0; long levelFrames[LIVE_LEVELS]={}; double deadlineMs=0;
+    double meanMs=0,p50Ms=0,p95Ms=0,p99Ms=0,maxMs=0;
+    double dropRate() const { return frames+dropped>0?(double)dropped/(frames+dropped):0.0; }
+};
+class LiveMeter{
+    std::vector<float> latencies; LiveStats st;
+public:
+    explicit LiveMeter(double deadlineMs){ st.deadlineMs=deadlineMs; }
+    void frame(double latencyMs,int skipped,int level);
+    LiveStats finish();
+};
+void printLiveStats(std::ostream &os,const LiveStats &st);
+#endif
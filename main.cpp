@@ -7,39 +7,199 @@
          No external source code beyond standard libraries and OpenCV.
 ********************************************************************************/
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
 #include <vector>
 #include <iostream>
-#include "detection.h"
-#include "classification.h"
-#include "heatmap.h"
+#include "profiler.h"
+#include "background.h"
+#include "stream.h"
+namespace fs=std::filesystem;
+
+static void usage(const char *prog){
+    std::cerr<<"Usage: "<<prog<<" <video_file> [--headless] [--debug] [--out <annotated_video>] [--pipeline [queue_depth]]\n"
+             <<"       "<<prog<<" --batch <list.txt|video_dir> [--workers N] [--outdir <dir>] [--pipeline [queue_depth]]\n"
+             <<"  common: [--config detector.yml] [--scale f] [--refine] [--bg mog2|average] [--field-refresh K] [--bands N] [--pitch <homography.yml|auto>] [--pitch-res cells_per_metre]\n"
+             <<"          [--window seconds] [--snapshot-every seconds] [--cache <dir>] [--frames [first:]last] [--profile [trace.json]]\n"
+             <<"          [--live [deadline_ms]]\n"
+             <<"  --headless  no windows and no frame pacing; writes annotated.mp4 unless --out is given\n"
+             <<"  --debug     show the field/player mask windows (ignored with --headless)\n"
+             <<"  --pipeline  run decode, detect, classify and output on separate threads (default queue depth 4)\n"
+             <<"  --config    detector parameters (cv::FileStorage YAML/XML, see README); later flags override it\n"
+             <<"  --scale f   run detection on the frame resized by f (0<f<=1, e.g. 0.5 for 1080p, 0.25 for 4K)\n"
+             <<"  --refine    with --scale, re-fit every box on a full-resolution window around it\n"
+             <<"  --bg        background model: mog2 (default) or average, a fixed-point running average that is\n"
+             <<"              cheaper per frame and meant for fixed cameras\n"
+             <<"  --field-refresh K  reuse the field mask for up to K frames (earlier on camera motion) and build\n"
+             <<"              the jersey mask only where there is foreground; 0 (default) recomputes everything\n"
+             <<"  --bands N   split each frame into N row bands processed in parallel (-1: one per core); same boxes\n"
+             <<"  --pitch     accumulate the heatmap on a 105x68 m pitch grid (default 2 cells per metre) through an\n"
+             <<"              image->pitch homography read from a file, or fitted to the field outline with \"auto\"\n"
+             <<"  --window    also keep a heatmap of the last <seconds> and write it to rolling/ every\n"
+             <<"              --snapshot-every seconds (default 60) from a background thread\n"
+             <<"  --cache     keep decoded frames in <dir> (raw, memory-mapped); later runs on the same unchanged\n"
+             <<"              video read them instead of decoding. The cache is filled by a run over the whole video\n"
+             <<"  --frames    only process frames first..last-1 (either may be omitted, e.g. 1500: or 3000)\n"
+             <<"  --profile   print p50/p95/p99 latency per stage (decode, MOG2, masks, contours, merge, features,\n"
+             <<"              k-means, tracking, output) at exit; with a .json path also write a Chrome trace\n"
+             <<"  --live      keep up with the input: drop frames when behind and shed work (cached jersey features,\n"
+             <<"              deferred heatmap, half detection scale) when frames take longer than the deadline\n"
+             <<"              (default one frame interval); files are replayed at their nominal frame rate\n"
+             <<"  --batch     process many videos headless on a pool of --workers threads (default: all cores),\n"
+             <<"              each into its own folder under --outdir (default: streams)\n";
+}
+
+static bool isVideoFile(const fs::path &p){
+    static const std::set<std::string> ext={".mp4",".avi",".mov",".mkv",".mpg",".mpeg",".m4v",".ts"};
+    std::string e=p.extension().string(); std::transform(e.begin(),e.end(),e.begin(),::tolower);
+    return ext.count(e)>0;
+}
+
+// A directory is scanned for video files; anything else is read as one path per line.
+static std::vector<std::string> listSources(const std::string &spec){
+    std::vector<std::string> out;
+    if(fs::is_directory(spec)){
+        for(auto &p:fs::directory_iterator(spec)) if(p.is_regular_file()&&isVideoFile(p.path())) out.push_back(p.path().string());
+        std::sort(out.begin(),out.end());
+    }else{
+        std::ifstream in(spec); std::string line;
+        while(std::getline(in,line)){
+            if(!line.empty()&&line.back()=='\r') line.pop_back();
+            if(!line.empty()&&line[0]!='#') out.push_back(line);
+        }
+    }
+    return out;
+}
+
+static int runBatch(const std::vector<std::string> &sources,int workers,const std::string &outRoot,const StreamOptions &base){
+    if(sources.empty()){ std::cerr<<"Error: no videos to process\n"; return -1; }
+    workers=std::max(1,std::min(workers,(int)sources.size()));
+    // Streams already keep every core busy; OpenCV's own thread pool would only add contention.
+    if(workers>1) cv::setNumThreads(1);
+    std::vector<StreamOptions> opts(sources.size(),base); std::set<std::string> dirs;
+    for(size_t i=0;i<sources.size();i++){
+        std::string name=fs::path(sources[i]).stem().string(), dir=(fs::path(outRoot)/name).string();
+        for(int k=1;dirs.count(dir);k++) dir=(fs::path(outRoot)/(name+"_"+std::to_string(k))).string();
+        dirs.insert(dir); fs::create_directories(dir);
+        opts[i].outDir=dir; opts[i].headless=true; opts[i].debug=false; opts[i].printStageStats=false; opts[i].outVideo.clear();
+    }
+    std::vector<StreamResult> results(sources.size());
+    std::atomic<size_t> next(0); std::mutex logMutex;
+    std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for(int w=0;w<workers;w++) pool.emplace_back([&,w]{
+        Profiler::setThreadName("worker "+std::to_string(w+1));
+        for(size_t i=next++;i<sources.size();i=next++){
+            results[i]=processStream(sources[i],opts[i]);
+            std::lock_guard<std::mutex> lk(logMutex);
+            std::cout<<"["<<(i+1)<<"/"<<sources.size()<<"] "<<sources[i]<<": "
+                     <<(results[i].ok?"":"FAILED, ")<<results[i].frames<<" frames, "
+                     <<(results[i].seconds>0?results[i].frames/results[i].seconds:0.0)<<" fps";
+            if(base.live) std::cout<<", "<<100.0*results[i].live.dropRate()<<"% dropped, p95 latency "<<results[i].live.p95Ms<<" ms";
+            std::cout<<" -> "<<opts[i].outDir<<"\n";
+        }
+    });
+    for(size_t i=0;i<pool.size();i++) pool[i].join();
+    double wall=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+    long frames=0; int failed=0;
+    for(size_t i=0;i<results.size();i++){ frames+=results[i].frames; if(!results[i].ok) failed++; }
+    if(!base.pitch.empty()){
+        // Pitch grids share one coordinate frame, so the streams add up to one combined map.
+        PitchHeatmap all(base.pitchGrid);
+        for(size_t i=0;i<results.size();i++) if(results[i].ok) all.merge(results[i].pitchGrids);
+        fs::create_directories(outRoot); all.saveAndShow(false,outRoot);
+        std::cout<<"Combined pitch heatmap -> "<<(fs::path(outRoot)/"pitch_heatmap.png").string()<<"\n";
+    }
+    std::cout<<"Processed "<<sources.size()<<" streams ("<<failed<<" failed) on "<<workers<<" workers: "
+             <<frames<<" frames in "<<wall<<" s, aggregate "<<(wall>0?frames/wall:0.0)<<" fps\n";
+    return failed?-1:0;
+}
+
+// Runs the parsed command line; main wraps it so the profile covers single and batch runs alike.
+static int runMain(const char *prog,const std::string &source,const std::string &batch,int workers,const std::string &outRoot,const StreamOptions &opt){
+    if(!batch.empty()) return runBatch(listSources(batch),workers,outRoot,opt);
+    if(source.empty()){ usage(prog); return -1; }
+    StreamResult res=processStream(source,opt);
+    if(!res.ok) return -1;
+    if(opt.live) printLiveStats(std::cout,res.live);
+    if(opt.headless){
+        const TeamModelStats &tm=res.teamModel;
+        std::cout<<"Processed "<<res.frames<<" frames in "<<res.seconds<<" s ("<<(res.seconds>0?res.frames/res.seconds:0.0)<<" fps)\n"
+                 <<"Team model: k-means on "<<tm.kmeansFrames<<" frames ("<<tm.driftReclusters<<" drift, "<<tm.refreshReclusters
+                 <<" refresh re-clusters), nearest-anchor on "<<tm.anchorFrames<<" frames\n"
+                 <<"Jersey features: "<<tm.featuresExtracted<<" extracted, "<<tm.featuresCached<<" reused from tracks\n";
+        const DetectorStats &ds=res.detector;
+        if(opt.detector.fieldRefresh>0)
+            std::cout<<"Field mask: recomputed on "<<ds.fieldRefreshes<<" of "<<ds.frames<<" frames ("<<ds.motionRefreshes<<" on camera motion), jersey mask built on "
+                     <<(ds.tiles?100.0*ds.activeTiles/ds.tiles:0.0)<<"% of tiles\n";
+        if(opt.windowSec>0) std::cout<<"Rolling heatmap: "<<res.snapshots<<" snapshots written, "<<res.snapshotsDropped<<" dropped\n";
+    }
+    else{ cv::waitKey(0); cv::destroyAllWindows(); }
+    return 0;
+}
 
 int main(int argc,char **argv){
-    if(argc<2){ std::cerr<<"Usage: "<<argv[0]<<" <video_file>\n"; return -1; }
-    cv::VideoCapture cap(argv[1]); if(!cap.isOpened()){ std::cerr<<"Error: could not open "<<argv[1]<<"\n"; return -1; }
-    std::ofstream det("ours.csv"); det<<"frame,x1,y1,x2,y2,team\n";
-    cv::Ptr<cv::BackgroundSubtractor> bg=cv::createBackgroundSubtractorMOG2(500,16,false);
-    double fps=cap.get(cv::CAP_PROP_FPS); int delay=fps>0?(int)(1000.0/fps):30;
-    cv::Mat frame; int idx=0; Heatmap hm;
-    std::vector<cv::Scalar> teamColors; teamColors.push_back(cv::Scalar(0,0,255)); teamColors.push_back(cv::Scalar(255,0,0)); teamColors.push_back(cv::Scalar(0,255,0));
-    while(cap.read(frame)){
-        std::vector<cv::Rect> boxes=detectPlayers(frame,bg);
-        std::vector<std::pair<cv::Rect,int> > cls=classifyPlayers(frame,boxes);
-        for(size_t i=0;i<cls.size();i++){
-            cv::Rect b=cls[i].first; int t=cls[i].second;
-            det<<idx<<","<<b.x<<","<<b.y<<","<<(b.x+b.width)<<","<<(b.y+b.height)<<","<<t<<"\n";
+    if(argc<2){ usage(argv[0]); return -1; }
+    StreamOptions opt; std::string source,batch,outRoot="streams",traceFile; bool profile=false;
+    int workers=(int)std::max(1u,std::thread::hardware_concurrency());
+    for(int i=1;i<argc;i++){
+        std::string a=argv[i];
+        if(a=="--headless") opt.headless=true;
+        else if(a=="--debug") opt.debug=true;
+        else if(a=="--out"&&i+1<argc) opt.outVideo=argv[++i];
+        else if(a=="--pipeline"){ opt.pipelined=true; if(i+1<argc&&std::isdigit((unsigned char)argv[i+1][0])) opt.queueDepth=std::max(1,std::atoi(argv[++i])); }
+        else if(a=="--config"&&i+1<argc){
+            std::string err; if(!loadDetectorConfig(argv[++i],opt.detector,&err)){ std::cerr<<"Error: "<<err<<"\n"; return -1; }
+        }
+        else if(a=="--scale"&&i+1<argc) opt.detector.scale=std::atof(argv[++i]);
+        else if(a=="--refine") opt.detector.refine=true;
+        else if(a=="--bg"&&i+1<argc){
+            if(!parseBackgroundKind(argv[++i],opt.detector.background)){ std::cerr<<"Error: --bg expects mog2 or average\n"; return -1; }
         }
-        for(size_t i=0;i<cls.size();i++){
-            cv::Rect b=cls[i].first; int t=cls[i].second; int cidx=(t==0||t==1)?t:2;
-            cv::rectangle(frame,b,teamColors[cidx],2);
-            cv::putText(frame,(t==0)?"Team A":(t==1)?"Team B":"Unknown",b.tl()+cv::Point(0,-5),cv::FONT_HERSHEY_SIMPLEX,0.5,teamColors[cidx],1);
+        else if(a=="--field-refresh"&&i+1<argc) opt.detector.fieldRefresh=std::atoi(argv[++i]);
+        else if(a=="--bands"&&i+1<argc) opt.detector.bands=std::atoi(argv[++i]);
+        else if(a=="--pitch"&&i+1<argc) opt.pitch=argv[++i];
+        else if(a=="--pitch-res"&&i+1<argc) opt.pitchGrid.cellsPerMetre=std::atoi(argv[++i]);
+        else if(a=="--window"&&i+1<argc) opt.windowSec=std::atof(argv[++i]);
+        else if(a=="--snapshot-every"&&i+1<argc) opt.snapshotSec=std::atof(argv[++i]);
+        else if(a=="--cache"&&i+1<argc) opt.cacheDir=argv[++i];
+        else if(a=="--frames"&&i+1<argc){
+            if(!parseFrameRange(argv[++i],opt.firstFrame,opt.lastFrame)){ std::cerr<<"Error: --frames expects first:last or last\n"; return -1; }
         }
-        hm.update(frame,cls);
-        idx++;
-        cv::imshow("Football Player Detection",frame);
-        char k=(char)cv::waitKey(delay); if(k==27||k=='q') break;
+        else if(a=="--profile"){
+            profile=true;
+            std::string next=i+1<argc?argv[i+1]:"";
+            if(next.size()>5&&next.compare(next.size()-5,5,".json")==0) traceFile=argv[++i];
+        }
+        else if(a=="--live"){ opt.live=true; if(i+1<argc&&std::isdigit((unsigned char)argv[i+1][0])) opt.deadlineMs=std::atof(argv[++i]); }
+        else if(a=="--batch"&&i+1<argc) batch=argv[++i];
+        else if(a=="--workers"&&i+1<argc) workers=std::max(1,std::atoi(argv[++i]));
+        else if(a=="--outdir"&&i+1<argc) outRoot=argv[++i];
+        else if(source.empty()&&a.compare(0,2,"--")!=0) source=a;
+        else{ usage(argv[0]); return -1; }
+    }
+    if(!(opt.detector.scale>0.0&&opt.detector.scale<=1.0)){ std::cerr<<"Error: --scale must be in (0,1]\n"; return -1; }
+    if(opt.detector.fieldRefresh<0){ std::cerr<<"Error: --field-refresh must not be negative\n"; return -1; }
+    if(opt.detector.bands<-1){ std::cerr<<"Error: --bands must be a band count or -1\n"; return -1; }
+    if((opt.detector.bands>1||opt.detector.bands<0)&&opt.detector.fieldRefresh>0) std::cerr<<"Warning: --bands is ignored with --field-refresh\n";
+    if(opt.pitchGrid.cellsPerMetre<1){ std::cerr<<"Error: --pitch-res must be a positive integer\n"; return -1; }
+    if(opt.windowSec<0||opt.snapshotSec<0){ std::cerr<<"Error: --window and --snapshot-every must not be negative\n"; return -1; }
+    if(opt.windowSec>0&&!opt.pitch.empty()){ std::cerr<<"Error: --window works on the image heatmap only, not with --pitch\n"; return -1; }
+    if(opt.live&&opt.pipelined){ std::cerr<<"Error: --live runs one frame at a time, not with --pipeline\n"; return -1; }
+    if(profile){ Profiler::enable(!traceFile.empty()); Profiler::setThreadName("main"); }
+    int rc=runMain(argv[0],source,batch,workers,outRoot,opt);
+    if(profile){
+        Profiler::report(std::cout);
+        std::string err;
+        if(!traceFile.empty()&&!Profiler::writeTrace(traceFile,&err)){ std::cerr<<"Error: "<<err<<"\n"; return -1; }
+        if(!traceFile.empty()) std::cout<<"Trace -> "<<traceFile<<"\n";
     }
-    hm.saveAndShow();
-    cv::waitKey(0);
-    det.close(); cap.release(); cv::destroyAllWindows(); return 0;
+    return rc;
 }
@@ -0,0 +1,89 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#include "pipeline.h"
+#include "profiler.h"
+#include <atomic>
+#include <iomanip>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+static double msSince(Clock::time_point t0){ return std::chrono::duration<double,std::milli>(Clock::now()-t0).count(); }
+
+static void runStage(BoundedQueue<FrameJob> &in,BoundedQueue<FrameJob> &out,const FramePipeline::Stage &fn,StageStats &s){
+    FrameJob job;
+    while(in.pop(job,s.starvedMs)){
+        Clock::time_point t0=Clock::now();
+        fn(job);
+        s.busyMs+=msSince(t0); s.frames++;
+        if(!out.push(std::move(job),s.blockedMs)) break;
+    }
+    out.close();
+}
+
+int FramePipeline::run(FrameSource &src,const Stage &detect,const Stage &classify,const Sink &output){
+    BoundedQueue<FrameJob> toDetect(depth),toClassify(depth),toOutput(depth);
+    BoundedQueue<cv::Mat> spare(3*depth+4); // frames handed back by the output stage for reuse by the decoder
+    stageStats.assign(4,StageStats());
+    stageStats[0].name="decode"; stageStats[1].name="detect"; stageStats[2].name="classify"; stageStats[3].name="output";
+    std::atomic<bool> stop(false);
+    src.setInFlight((int)(3*depth+8)); // queued frames plus one in every stage
+
+    std::thread decoder([&]{
+        StageStats &s=stageStats[0];
+        Profiler::setThreadName("decode");
+        while(!stop){
+            FrameJob job; job.idx=src.nextIndex();
+            spare.tryPop(job.frame);
+            Clock::time_point t0=Clock::now();
+            bool ok;
+            { PROFILE_SCOPE("decode"); ok=src.read(job.frame); }
+            if(!ok) break;
+            s.busyMs+=msSince(t0); s.frames++;
+            if(!toDetect.push(std::move(job),s.blockedMs)) break;
+        }
+        toDetect.close();
+    });
+    std::thread detector([&]{ Profiler::setThreadName("detect"); runStage(toDetect,toClassify,detect,stageStats[1]); });
+    std::thread classifier([&]{ Profiler::setThreadName("classify"); runStage(toClassify,toOutput,classify,stageStats[2]); });
+
+    StageStats &s=stageStats[3]; FrameJob job; int n=0;
+    while(toOutput.pop(job,s.starvedMs)){
+        Clock::time_point t0=Clock::now();
+        bool more=output(job);
+        s.busyMs+=msSince(t0); s.frames++; n++;
+        spare.tryPush(std::move(job.frame));
+        if(!more){ stop=true; break; }
+    }
+    if(stop){ toDetect.close(); toClassify.close(); toOutput.close(); }
+    decoder.join(); detector.join(); classifier.join();
+
+    BoundedQueue<FrameJob> *inputs[4]={NULL,&toDetect,&toClassify,&toOutput};
+    for(int i=1;i<4;i++){
+        stageStats[i].inCapacity=inputs[i]->capacity();
+        stageStats[i].inPeakDepth=inputs[i]->peakDepth();
+        stageStats[i].inMeanDepth=inputs[i]->meanDepth();
+    }
+    return n;
+}
+
+void FramePipeline::printStats(std::ostream &os) const {
+    os<<"stage     frames   busy ms  starved ms  blocked ms  ms/frame  in-queue mean/peak/cap\n";
+    for(size_t i=0;i<stageStats.size();i++){
+        const StageStats &s=stageStats[i];
+        os<<std::left<<std::setw(9)<<s.name<<std::right<<std::setw(7)<<s.frames
+          <<std::fixed<<std::setprecision(1)
+          <<std::setw(10)<<s.busyMs<<std::setw(12)<<s.starvedMs<<std::setw(12)<<s.blockedMs
+          <<std::setprecision(2)<<std::setw(10)<<(s.frames?s.busyMs/s.frames:0.0);
+        if(i==0) os<<"  -\n";
+        else os<<"  "<<std::setprecision(2)<<s.inMeanDepth<<"/"<<s.inPeakDepth<<"/"<<s.inCapacity<<"\n";
+    }
+    size_t slow=0;
+    for(size_t i=1;i<stageStats.size();i++) if(stageStats[i].busyMs>stageStats[slow].busyMs) slow=i;
+    if(!stageStats.empty()) os<<"bottleneck: "<<stageStats[slow].name<<"\n";
+}
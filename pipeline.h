@@ -0,0 +1,98 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "classification.h"
+#include "framesource.h"
+
+// Fixed-capacity FIFO between two pipeline stages. push() blocks while full (backpressure),
+// pop() blocks while empty; both record how long the caller was stalled.
+template<typename T> class BoundedQueue{
+    std::mutex m; std::condition_variable notFull,notEmpty; std::deque<T> q; size_t cap; bool closed=false;
+    size_t maxDepth=0; double depthSum=0; long depthSamples=0;
+public:
+    explicit BoundedQueue(size_t capacity):cap(capacity>0?capacity:1){}
+    bool push(T v,double &stallMs){
+        std::unique_lock<std::mutex> lk(m);
+        if(q.size()>=cap&&!closed){
+            std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+            notFull.wait(lk,[this]{ return q.size()<cap||closed; });
+            stallMs+=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-t0).count();
+        }
+        if(closed) return false;
+        q.push_back(std::move(v));
+        if(q.size()>maxDepth) maxDepth=q.size();
+        depthSum+=q.size(); depthSamples++;
+        notEmpty.notify_one(); return true;
+    }
+    bool pop(T &v,double &stallMs){
+        std::unique_lock<std::mutex> lk(m);
+        if(q.empty()&&!closed){
+            std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+            notEmpty.wait(lk,[this]{ return !q.empty()||closed; });
+            stallMs+=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-t0).count();
+        }
+        if(q.empty()) return false;
+        v=std::move(q.front()); q.pop_front();
+        notFull.notify_one(); return true;
+    }
+    bool tryPush(T v){
+        std::lock_guard<std::mutex> lk(m);
+        if(closed||q.size()>=cap) return false;
+        q.push_back(std::move(v)); notEmpty.notify_one(); return true;
+    }
+    bool tryPop(T &v){
+        std::lock_guard<std::mutex> lk(m);
+        if(q.empty()) return false;
+        v=std::move(q.front()); q.pop_front(); notFull.notify_one(); return true;
+    }
+    // After close() pushes fail and pop() drains what is left, then returns false.
+    void close(){ std::lock_guard<std::mutex> lk(m); closed=true; notFull.notify_all(); notEmpty.notify_all(); }
+    size_t peakDepth(){ std::lock_guard<std::mutex> lk(m); return maxDepth; }
+    double meanDepth(){ std::lock_guard<std::mutex> lk(m); return depthSamples?depthSum/depthSamples:0.0; }
+    size_t capacity() const { return cap; }
+};
+
+struct FrameJob{
+    int idx=0; cv::Mat frame;
+    std::vector<cv::Rect> boxes;
+    std::vector<ClassifiedPlayer> classified;
+    cv::Mat homography; // image -> pitch, pitch heatmap mode only
+};
+
+// busyMs: time doing work; starvedMs: waiting on an empty input queue; blockedMs: waiting on a full output queue.
+struct StageStats{
+    std::string name; long frames=0; double busyMs=0,starvedMs=0,blockedMs=0;
+    size_t inCapacity=0,inPeakDepth=0; double inMeanDepth=0;
+};
+
+// decode -> detect -> classify -> output, one thread per stage and bounded queues in between.
+// Every stage is a single thread reading a FIFO, so frames reach the output in decode order and
+// stateful steps (MOG2, team anchors, tracking) see them sequentially. The output callback runs on
+// the calling thread so it may use HighGUI; returning false stops the pipeline.
+class FramePipeline{
+public:
+    typedef std::function<void(FrameJob&)> Stage;
+    typedef std::function<bool(FrameJob&)> Sink;
+    explicit FramePipeline(size_t queueDepth=4):depth(queueDepth){}
+    int run(FrameSource &src,const Stage &detect,const Stage &classify,const Sink &output);
+    const std::vector<StageStats> &stats() const { return stageStats; }
+    void printStats(std::ostream &os) const;
+private:
+    size_t depth; std::vector<StageStats> stageStats;
+};
+#endif
@@ -0,0 +1,140 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#include "profiler.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+bool Profiler::on=false;
+
+// Log-linear latency histogram: 16 buckets per power of two, so a percentile lands within about 4%
+// of the exact sample; values below 16 ns get a bucket each. Longer samples than 2^40 ns (about
+// 18 minutes) are counted in the last bucket.
+static const int SUB_BITS=4, SUB=1<<SUB_BITS, MAX_EXP=40;
+static const int BUCKETS=(MAX_EXP-SUB_BITS+2)*SUB;
+static const size_t MAX_TRACE_EVENTS=1<<20; // per thread, 24 bytes each
+
+static int bucketOf(int64_t v){
+    if(v<SUB) return v<0?0:(int)v;
+    if(v>=((int64_t)1<<(MAX_EXP+1))) return BUCKETS-1;
+    int e=63-__builtin_clzll((unsigned long long)v);
+    return (e-SUB_BITS+1)*SUB+(int)((v>>(e-SUB_BITS))&(SUB-1));
+}
+static double bucketMid(int b){
+    if(b<SUB) return b;
+    int e=b/SUB+SUB_BITS-1, m=b%SUB;
+    double width=std::ldexp(1.0,e-SUB_BITS);
+    return (SUB+m)*width+width/2;
+}
+
+struct StageLog{ long calls=0; int64_t totalNs=0,minNs=INT64_MAX,maxNs=0; std::vector<uint32_t> hist; };
+struct TraceEvent{ int id; int64_t startNs,durNs; };
+struct ThreadLog{ int tid=0; std::string name; std::vector<StageLog> stages; std::vector<TraceEvent> events; long dropped=0; };
+
+// Thread logs outlive their threads (batch workers exit before the report), so the registry owns them.
+static std::mutex registryMutex;
+static std::vector<std::string> stageNames;
+static std::vector<std::unique_ptr<ThreadLog>> threadLogs;
+static bool traceOn=false; static int64_t epochNs=0;
+
+static ThreadLog &threadLog(){
+    thread_local ThreadLog *log=nullptr;
+    if(!log){
+        std::lock_guard<std::mutex> lk(registryMutex);
+        threadLogs.emplace_back(new ThreadLog()); log=threadLogs.back().get(); log->tid=(int)threadLogs.size();
+    }
+    return *log;
+}
+
+void Profiler::enable(bool traceEvents){ on=true; traceOn=traceEvents; epochNs=nowNs(); }
+
+int Profiler::stage(const char *name){
+    std::lock_guard<std::mutex> lk(registryMutex);
+    for(size_t i=0;i<stageNames.size();i++) if(stageNames[i]==name) return (int)i;
+    stageNames.push_back(name); return (int)stageNames.size()-1;
+}
+
+void Profiler::record(int id,int64_t startNs,int64_t durNs){
+    ThreadLog &t=threadLog();
+    if(id>=(int)t.stages.size()) t.stages.resize(id+1);
+    StageLog &s=t.stages[id];
+    if(s.hist.empty()) s.hist.assign(BUCKETS,0);
+    s.calls++; s.totalNs+=durNs; s.minNs=std::min(s.minNs,durNs); s.maxNs=std::max(s.maxNs,durNs);
+    s.hist[bucketOf(durNs)]++;
+    if(!traceOn) return;
+    if(t.events.size()<MAX_TRACE_EVENTS){ TraceEvent e={id,startNs,durNs}; t.events.push_back(e); }
+    else t.dropped++;
+}
+
+void Profiler::setThreadName(const std::string &name){ if(on) threadLog().name=name; }
+
+static double percentileNs(const std::vector<uint64_t> &hist,long calls,int64_t minNs,int64_t maxNs,double p){
+    uint64_t target=(uint64_t)std::max(1.0,std::ceil(p*calls)), seen=0;
+    for(int b=0;b<BUCKETS;b++){
+        seen+=hist[b];
+        if(seen>=target) return std::min((double)maxNs,std::max((double)minNs,bucketMid(b)));
+    }
+    return (double)maxNs;
+}
+
+void Profiler::report(std::ostream &os){
+    if(!on) return;
+    std::lock_guard<std::mutex> lk(registryMutex);
+    std::ios::fmtflags flags=os.flags(); std::streamsize prec=os.precision();
+    os<<"stage                    calls   total ms   mean ms    p50 ms    p95 ms    p99 ms    max ms\n";
+    long dropped=0;
+    for(size_t i=0;i<threadLogs.size();i++) dropped+=threadLogs[i]->dropped;
+    for(size_t id=0;id<stageNames.size();id++){
+        long calls=0; int64_t total=0,mn=INT64_MAX,mx=0; std::vector<uint64_t> hist(BUCKETS,0);
+        for(size_t i=0;i<threadLogs.size();i++){
+            const ThreadLog &t=*threadLogs[i];
+            if(id>=t.stages.size()||t.stages[id].calls==0) continue;
+            const StageLog &s=t.stages[id];
+            calls+=s.calls; total+=s.totalNs; mn=std::min(mn,s.minNs); mx=std::max(mx,s.maxNs);
+            for(int b=0;b<BUCKETS;b++) hist[b]+=s.hist[b];
+        }
+        if(calls==0) continue;
+        os<<std::left<<std::setw(22)<<stageNames[id]<<std::right<<std::setw(8)<<calls<<std::fixed<<std::setprecision(1)
+          <<std::setw(11)<<total/1e6<<std::setprecision(3)<<std::setw(10)<<total/1e6/calls;
+        const double ps[3]={0.50,0.95,0.99};
+        for(int k=0;k<3;k++) os<<std::setw(10)<<percentileNs(hist,calls,mn,mx,ps[k])/1e6;
+        os<<std::setw(10)<<mx/1e6<<"\n";
+    }
+    if(dropped) os<<"trace: "<<dropped<<" events past the per-thread limit were not kept\n";
+    os.flags(flags); os.precision(prec);
+}
+
+bool Profiler::writeTrace(const std::string &path,std::string *err){
+    if(!traceOn){ if(err) *err="tracing was not enabled"; return false; }
+    std::ofstream out(path);
+    if(!out){ if(err) *err="could not write "+path; return false; }
+    std::lock_guard<std::mutex> lk(registryMutex);
+    // Complete ("X") events with microsecond timestamps from enable(), one row per thread.
+    out<<"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"<<std::fixed<<std::setprecision(3);
+    bool first=true;
+    for(size_t i=0;i<threadLogs.size();i++){
+        const ThreadLog &t=*threadLogs[i];
+        std::string name=t.name.empty()?"thread "+std::to_string(t.tid):t.name;
+        out<<(first?"":",\n")<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"<<t.tid<<",\"args\":{\"name\":\""<<name<<"\"}}";
+        first=false;
+        for(size_t k=0;k<t.events.size();k++){
+            const TraceEvent &e=t.events[k];
+            out<<",\n{\"name\":\""<<stageNames[e.id]<<"\",\"ph\":\"X\",\"pid\":1,\"tid\":"<<t.tid
+               <<",\"ts\":"<<(e.startNs-epochNs)/1e3<<",\"dur\":"<<e.durNs/1e3<<"}";
+        }
+    }
+    out<<"\n]}\n";
+    if(!out){ if(err) *err="could not write "+path; return false; }
+    return true;
+}
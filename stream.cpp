@@ -0,0 +1,185 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#include "stream.h"
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "detection.h"
+#include "classification.h"
+#include "detfile.h"
+#include "framesource.h"
+#include "heatmap.h"
+#include "pipeline.h"
+#include "profiler.h"
+
+// Auto pitch mode re-fits the homography this often, so slow camera pans are followed.
+static const int PITCH_REESTIMATE_INTERVAL=25;
+// Live mode: at most this many frames of heatmap updates are held back before they are applied anyway.
+static const size_t HEATMAP_DEFER_MAX=250;
+static const double MIN_LIVE_SCALE=0.125;
+
+StreamResult processStream(const std::string &source,const StreamOptions &opt){
+    StreamResult res; res.source=source;
+    std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+    bool debug=opt.debug&&!opt.headless&&!opt.pipelined; // HighGUI calls must stay on the main thread
+    std::string prefix=opt.outDir.empty()?std::string():opt.outDir+"/";
+    std::string outVideo=opt.outVideo;
+    if(opt.headless&&outVideo.empty()) outVideo=prefix+"annotated.mp4";
+    FrameSourceOptions srcOpt; srcOpt.cacheDir=opt.cacheDir; srcOpt.first=opt.firstFrame; srcOpt.last=opt.lastFrame;
+    std::string srcErr; std::unique_ptr<FrameSource> src=openFrameSource(source,srcOpt,&srcErr);
+    if(!src){ std::cerr<<"Error: "<<srcErr<<"\n"; return res; }
+    std::ofstream det(prefix+"ours.csv"); det<<"frame,x1,y1,x2,y2,team,track_id\n";
+    if(!det){ std::cerr<<"Error: could not write "<<prefix<<"ours.csv\n"; return res; }
+    DetectionWriter bin; // same rows as ours.csv in the binary format
+    if(!bin.open(prefix+"ours.bin",DET_HAS_TEAM|DET_HAS_TRACK)){ std::cerr<<"Error: could not write "<<prefix<<"ours.bin\n"; return res; }
+    PlayerDetector detector(opt.detector); detector.setDebug(debug);
+    TeamClassifier classifier;
+    double fps=src->fps(); int delay=fps>0?(int)(1000.0/fps):30;
+    cv::VideoWriter writer; bool writeFailed=false;
+    int emitted=0; Heatmap hm;
+    // Pitch mode: pitchH is the fixed homography, or the latest estimate (touched by the detect stage only).
+    bool pitchMode=!opt.pitch.empty(), pitchAuto=opt.pitch=="auto";
+    PitchHeatmap pitchHm(opt.pitchGrid); cv::Mat pitchH;
+    if(pitchMode&&!pitchAuto&&!PitchHeatmap::loadHomography(opt.pitch,pitchH)){ std::cerr<<"Error: no 3x3 \"homography\" in "<<opt.pitch<<"\n"; return res; }
+    std::unique_ptr<RollingHeatmap> rolling;
+    if(opt.windowSec>0){
+        double rate=fps>0?fps:25.0, every=std::min(opt.snapshotSec>0?opt.snapshotSec:opt.windowSec,opt.windowSec);
+        RollingConfig rc; rc.intervalFrames=std::max(1,(int)std::lround(every*rate));
+        rc.windowIntervals=std::max(1,(int)std::ceil(opt.windowSec/every-1e-9));
+        rolling.reset(new RollingHeatmap(rc,prefix+"rolling"));
+    }
+    auto homographyFor=[&](int fidx)->cv::Mat{
+        if(pitchAuto&&(pitchH.empty()||fidx%PITCH_REESTIMATE_INTERVAL==0)){
+            PROFILE_SCOPE("detect.homography");
+            cv::Mat h; if(PitchHeatmap::estimateHomography(detector.fieldMask(),1.0/detector.config().scale,opt.pitchGrid,h)) pitchH=h;
+        }
+        return pitchH;
+    };
+    // Live mode at LIVE_DEFER_HEATMAP and above queues the heatmap updates and applies them once
+    // it is back below that level (or the queue is full).
+    struct DeferredUpdate{ std::vector<ClassifiedPlayer> cls; cv::Mat H; };
+    std::vector<DeferredUpdate> deferred; bool deferHeatmap=false;
+    auto applyDeferred=[&](const cv::Mat &frame){
+        for(size_t i=0;i<deferred.size();i++){ if(pitchMode) pitchHm.update(deferred[i].H,deferred[i].cls); else hm.update(frame,deferred[i].cls); }
+        deferred.clear();
+    };
+    std::vector<cv::Scalar> teamColors; teamColors.push_back(cv::Scalar(0,0,255)); teamColors.push_back(cv::Scalar(255,0,0)); teamColors.push_back(cv::Scalar(0,255,0));
+
+    // CSV, annotation, heatmap, video and display for one classified frame; false stops the run.
+    auto emit=[&](int fidx,cv::Mat &frame,const std::vector<ClassifiedPlayer> &cls,const cv::Mat &H)->bool{
+        PROFILE_SCOPE("output");
+        {
+            PROFILE_SCOPE("output.files");
+            for(size_t i=0;i<cls.size();i++){
+                cv::Rect b=cls[i].box; int t=cls[i].team;
+                det<<fidx<<","<<b.x<<","<<b.y<<","<<(b.x+b.width)<<","<<(b.y+b.height)<<","<<t<<","<<cls[i].trackId<<"\n";
+                DetRecord r={fidx,(float)b.x,(float)b.y,(float)(b.x+b.width),(float)(b.y+b.height),t,cls[i].trackId};
+                bin.add(r);
+            }
+        }
+        {
+            PROFILE_SCOPE("output.draw");
+            for(size_t i=0;i<cls.size();i++){
+                cv::Rect b=cls[i].box; int t=cls[i].team; int cidx=(t==0||t==1)?t:2;
+                cv::rectangle(frame,b,teamColors[cidx],2);
+                cv::putText(frame,std::string((t==0)?"Team A":(t==1)?"Team B":"Unknown")+" #"+std::to_string(cls[i].trackId),b.tl()+cv::Point(0,-5),cv::FONT_HERSHEY_SIMPLEX,0.5,teamColors[cidx],1);
+            }
+        }
+        {
+            PROFILE_SCOPE("output.heatmap");
+            if(deferHeatmap&&deferred.size()<HEATMAP_DEFER_MAX){ DeferredUpdate u; u.cls=cls; u.H=H; deferred.push_back(u); }
+            else{
+                applyDeferred(frame);
+                if(pitchMode) pitchHm.update(H,cls); else hm.update(frame,cls);
+            }
+            if(rolling) rolling->update(frame,cls);
+        }
+        emitted++;
+        if(!outVideo.empty()){
+            PROFILE_SCOPE("output.video");
+            if(!writer.isOpened()&&!writer.open(outVideo,cv::VideoWriter::fourcc('m','p','4','v'),fps>0?fps:25.0,frame.size())){
+                std::cerr<<"Error: could not write "<<outVideo<<"\n"; writeFailed=true; return false;
+            }
+            writer.write(frame);
+        }
+        if(opt.headless) return true;
+        cv::imshow("Football Player Detection",frame);
+        char k=(char)cv::waitKey(opt.live?1:delay); return !(k==27||k=='q'); // live frames are paced by the feed
+    };
+
+    // The serial loop and the pipeline stages run the same three steps.
+    auto detectFrame=[&](int fidx,const cv::Mat &frame,std::vector<cv::Rect> &boxes,cv::Mat &H){
+        PROFILE_SCOPE("detect");
+        detector.detect(frame,boxes);
+        if(pitchMode) H=homographyFor(fidx);
+    };
+    auto classifyFrame=[&](const cv::Mat &frame,const std::vector<cv::Rect> &boxes){
+        PROFILE_SCOPE("classify");
+        return classifier.classify(frame,boxes);
+    };
+    if(opt.pipelined){
+        FramePipeline pipe((size_t)opt.queueDepth);
+        pipe.run(*src,
+            [&](FrameJob &job){ detectFrame(job.idx,job.frame,job.boxes,job.homography); },
+            [&](FrameJob &job){ job.classified=classifyFrame(job.frame,job.boxes); },
+            [&](FrameJob &job){ return emit(job.idx,job.frame,job.classified,job.homography); });
+        if(opt.printStageStats) pipe.printStats(std::cout);
+    }else if(opt.live){
+        // A file is replayed at its nominal rate; cameras and streams pace themselves.
+        std::error_code ec; bool paced=std::filesystem::is_regular_file(source,ec);
+        const double deadline=opt.deadlineMs>0?opt.deadlineMs:1000.0/(fps>0?fps:25.0), baseScale=detector.config().scale;
+        LiveFeed feed(*src,paced);
+        QualityController quality(deadline,baseScale*0.5>=MIN_LIVE_SCALE?LIVE_HALF_SCALE:LIVE_DEFER_HEATMAP);
+        LiveMeter meter(deadline);
+        cv::Mat frame,H; std::vector<cv::Rect> boxes; int n,skipped,level=LIVE_FULL;
+        std::chrono::steady_clock::time_point arrival;
+        while(feed.next(frame,n,arrival,skipped)){
+            std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+            if(skipped>0){ detector.skipFrames(skipped); classifier.skipFrames(skipped); }
+            detectFrame(n,frame,boxes,H);
+            std::vector<ClassifiedPlayer> cls=classifyFrame(frame,boxes);
+            bool more=emit(n,frame,cls,H);
+            std::chrono::steady_clock::time_point end=std::chrono::steady_clock::now();
+            meter.frame(std::chrono::duration<double,std::milli>(end-arrival).count(),skipped,level);
+            int next=quality.update(std::chrono::duration<double,std::milli>(end-start).count());
+            if(next!=level){
+                level=next;
+                classifier.setReuseFeatures(level>=LIVE_CACHED_FEATURES);
+                deferHeatmap=level>=LIVE_DEFER_HEATMAP;
+                detector.setScale(level>=LIVE_HALF_SCALE?baseScale*0.5:baseScale);
+            }
+            if(!more) break;
+        }
+        feed.stop();
+        applyDeferred(frame);
+        res.live=meter.finish();
+    }else{
+        cv::Mat frame,H; std::vector<cv::Rect> boxes;
+        auto decode=[&]{ PROFILE_SCOPE("decode"); return src->read(frame); };
+        for(int n=src->nextIndex();decode();n=src->nextIndex()){
+            detectFrame(n,frame,boxes,H);
+            std::vector<ClassifiedPlayer> cls=classifyFrame(frame,boxes);
+            if(!emit(n,frame,cls,H)) break;
+        }
+    }
+    writer.release(); det.close(); src.reset();
+    if(!bin.close()){ std::cerr<<"Error: could not write "<<prefix<<"ours.bin\n"; return res; }
+    if(rolling){ rolling->finish(); res.snapshots=rolling->snapshotsWritten(); res.snapshotsDropped=rolling->snapshotsDropped(); }
+    res.frames=emitted; res.teamModel=classifier.stats(); res.detector=detector.stats();
+    res.seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+    if(writeFailed) return res;
+    if(pitchMode){ pitchHm.saveAndShow(!opt.headless,opt.outDir); res.pitchGrids=pitchHm.teamGrids(); }
+    else hm.saveAndShow(!opt.headless,opt.outDir);
+    res.ok=true; return res;
+}
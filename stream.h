@@ -0,0 +1,32 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#ifndef STREAM_H
+#define STREAM_H
+#include <string>
+#include <vector>
+#include "classification.h"
+#include "detection.h"
+#include "heatmap.h"
+#include "live.h"
+struct StreamOptions{
+    bool headless=false,debug=false,pipelined=false,printStageStats=true; int queueDepth=4;
+    std::string outDir;   // ours.csv, heatmaps and the default annotated video go here (current directory when empty)
+    std::string outVideo; // annotated video; headless runs default to <outDir>/annotated.mp4
+    DetectorConfig detector;
+    std::string pitch;    // pitch-plane heatmap instead of the image one: a homography file, or "auto" to fit it to the field mask
+    PitchConfig pitchGrid;
+    std::string cacheDir; int firstFrame=0,lastFrame=-1; // decoded-frame cache ("" = off) and frame range [first,last)
+    double windowSec=0,snapshotSec=60; // rolling heatmap over the last windowSec seconds, snapshot every snapshotSec (off when 0)
+    bool live=false; double deadlineMs=0; // drop frames and shed work to keep up; deadline 0 = one frame interval
+};
+struct StreamResult{ std::string source; bool ok=false; int frames=0; double seconds=0; TeamModelStats teamModel; DetectorStats detector; std::vector<cv::Mat> pitchGrids; long snapshots=0,snapshotsDropped=0; LiveStats live; };
+// Detects, classifies and writes outputs for one video. Every piece of per-video state (detector,
+// classifier, heatmap, writers) is local to the call, so calls on different threads are independent.
+StreamResult processStream(const std::string &source,const StreamOptions &opt);
+#endif
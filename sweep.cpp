@@ -0,0 +1,322 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+// sweep.cpp
+// Usage: ./sweep <video> <gt.csv|gt.bin> [--base detector.yml] [--configs list.yml] [--vary key=v1,v2,...]...
+//                [--iou 0.5] [--gt-offset 0] [--frames [first:]last] [--cache dir] [--workers N] [--best best.yml]
+// Runs the detector with many parameter sets over one video and ranks them against a reference.
+// The video is decoded once; every batch of frames is shared by all configurations, which run on
+// a pool of worker threads, and each configuration is scored in process with the evaluation engine.
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "detection.h"
+#include "evaluation.h"
+#include "framesource.h"
+
+static const int BATCH_FRAMES = 32;
+
+struct SweepRun
+{
+    std::string name;
+    DetectorConfig cfg;
+    std::unique_ptr<PlayerDetector> detector;
+    FrameBoxes pred;
+    std::vector<cv::Rect> boxes;
+    std::vector<EvalBox> frameBoxes;
+    double ms = 0;
+    EvalCounts score;
+};
+
+static void usage(const char *prog)
+{
+    std::cerr << "Usage: " << prog << " <video> <gt.csv|gt.bin> [options]\n"
+              << "  --base <yml>       detector parameters every configuration starts from\n"
+              << "  --configs <yml>    list of configurations: configs: [ { name: a, learning_rate: 0.005 }, ... ]\n"
+              << "  --vary key=v1,v2   try each value; several --vary flags give every combination\n"
+              << "  --iou t            IoU threshold for a true positive (default 0.5)\n"
+              << "  --gt-offset n      added to the reference frame numbers (default 0)\n"
+              << "  --frames a:b       only frames a..b-1 (a plain n means 0:n)\n"
+              << "  --cache <dir>      decoded-frame cache shared with detect --cache\n"
+              << "  --workers n        worker threads (default: all cores)\n"
+              << "  --best <yml>       write the best configuration (default best_config.yml)\n"
+              << "  parameters: ";
+    for (const std::string &k : detectorParamNames())
+        std::cerr << k << " ";
+    std::cerr << "\n";
+}
+
+// key=v1,v2,... -> one (key, value) list per --vary flag.
+static bool parseVary(const std::string &spec, std::pair<std::string, std::vector<double>> &out)
+{
+    size_t eq = spec.find('=');
+    if (eq == std::string::npos || eq == 0)
+        return false;
+    out.first = spec.substr(0, eq);
+    double probe;
+    DetectorConfig tmp;
+    if (!getDetectorParam(tmp, out.first, probe))
+        return false;
+    std::stringstream ss(spec.substr(eq + 1));
+    std::string tok;
+    while (std::getline(ss, tok, ','))
+    {
+        char *end = nullptr;
+        double v = std::strtod(tok.c_str(), &end);
+        if (tok.empty() || *end)
+            return false;
+        out.second.push_back(v);
+    }
+    return !out.second.empty();
+}
+
+static std::string formatValue(double v)
+{
+    std::ostringstream os;
+    os << v;
+    return os.str();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    const std::string video = argv[1], gtPath = argv[2];
+    std::string basePath, listPath, bestPath = "best_config.yml";
+    std::vector<std::pair<std::string, std::vector<double>>> vary;
+    double iouThr = 0.5;
+    int gtOffset = 0;
+    FrameSourceOptions srcOpt;
+    int workers = (int)std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 3; i < argc; ++i)
+    {
+        const std::string a = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (a == "--base" && hasValue)
+            basePath = argv[++i];
+        else if (a == "--configs" && hasValue)
+            listPath = argv[++i];
+        else if (a == "--vary" && hasValue)
+        {
+            std::pair<std::string, std::vector<double>> v;
+            if (!parseVary(argv[++i], v))
+            {
+                std::cerr << "Bad --vary '" << argv[i] << "'\n";
+                usage(argv[0]);
+                return 1;
+            }
+            vary.push_back(v);
+        }
+        else if (a == "--iou" && hasValue)
+            iouThr = std::atof(argv[++i]);
+        else if (a == "--gt-offset" && hasValue)
+            gtOffset = std::atoi(argv[++i]);
+        else if (a == "--frames" && hasValue)
+        {
+            if (!parseFrameRange(argv[++i], srcOpt.first, srcOpt.last))
+            {
+                std::cerr << "Bad --frames range, expected first:last or last\n";
+                return 1;
+            }
+        }
+        else if (a == "--cache" && hasValue)
+            srcOpt.cacheDir = argv[++i];
+        else if (a == "--workers" && hasValue)
+            workers = std::max(1, std::atoi(argv[++i]));
+        else if (a == "--best" && hasValue)
+            bestPath = argv[++i];
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    DetectorConfig base;
+    std::string err;
+    if (!basePath.empty() && !loadDetectorConfig(basePath, base, &err))
+    {
+        std::cerr << "Config error: " << err << "\n";
+        return 1;
+    }
+
+    // Configurations: an explicit list, otherwise every combination of the --vary values.
+    std::vector<std::unique_ptr<SweepRun>> runs;
+    if (!listPath.empty())
+    {
+        cv::FileStorage fs(listPath, cv::FileStorage::READ);
+        cv::FileNode list = fs.isOpened() ? fs["configs"] : cv::FileNode();
+        if (!list.isSeq())
+        {
+            std::cerr << "Config error: " << listPath << " has no 'configs' list\n";
+            return 1;
+        }
+        int k = 0;
+        for (cv::FileNodeIterator it = list.begin(); it != list.end(); ++it, ++k)
+        {
+            std::unique_ptr<SweepRun> r(new SweepRun);
+            r->cfg = base;
+            if (!readDetectorConfig(*it, r->cfg, &err))
+            {
+                std::cerr << "Config error: " << listPath << " entry " << k << ": " << err << "\n";
+                return 1;
+            }
+            r->name = (*it)["name"].isString() ? (std::string)(*it)["name"] : "config " + std::to_string(k);
+            runs.push_back(std::move(r));
+        }
+    }
+    else
+    {
+        std::vector<size_t> digit(vary.size(), 0);
+        while (true)
+        {
+            std::unique_ptr<SweepRun> r(new SweepRun);
+            r->cfg = base;
+            for (size_t v = 0; v < vary.size(); ++v)
+            {
+                setDetectorParam(r->cfg, vary[v].first, vary[v].second[digit[v]]);
+                r->name += (v ? " " : "") + vary[v].first + "=" + formatValue(vary[v].second[digit[v]]);
+            }
+            if (r->name.empty())
+                r->name = basePath.empty() ? "default" : basePath;
+            runs.push_back(std::move(r));
+            size_t v = 0;
+            while (v < vary.size() && ++digit[v] == vary[v].second.size())
+                digit[v++] = 0;
+            if (v == vary.size())
+                break;
+        }
+    }
+    if (runs.empty())
+    {
+        std::cerr << "Config error: no configurations\n";
+        return 1;
+    }
+    for (auto &r : runs)
+    {
+        if (!(r->cfg.scale > 0.0 && r->cfg.scale <= 1.0))
+        {
+            std::cerr << "Config error: " << r->name << ": scale must be in (0,1]\n";
+            return 1;
+        }
+        r->detector.reset(new PlayerDetector(r->cfg));
+    }
+
+    FrameBoxes gt;
+    if (!loadFrameBoxes(gtPath, gtOffset, gt, &err))
+    {
+        std::cerr << "Load error: " << err << "\n";
+        return 2;
+    }
+    std::unique_ptr<FrameSource> src = openFrameSource(video, srcOpt, &err);
+    if (!src)
+    {
+        std::cerr << "Cannot open " << video << ": " << err << "\n";
+        return 2;
+    }
+    src->setInFlight(2 * BATCH_FRAMES + 2); // current and next batch
+    for (auto &r : runs)
+        r->pred.firstFrame = src->nextIndex();
+    workers = std::min(workers, (int)runs.size());
+    // Configurations already keep every core busy; OpenCV's own threads would only contend.
+    if (workers > 1)
+        cv::setNumThreads(1);
+    std::cout << runs.size() << " configurations on " << workers << " workers\n";
+
+    // Decoding of the next batch overlaps detection on the current one.
+    int decoded = 0;
+    auto decode = [&](std::vector<cv::Mat> &buf)
+    {
+        int n = 0;
+        while (n < BATCH_FRAMES && src->read(buf[n]))
+        {
+            n++;
+            decoded++;
+        }
+        return n;
+    };
+    std::vector<cv::Mat> cur(BATCH_FRAMES), next(BATCH_FRAMES);
+    int n = decode(cur);
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    while (n > 0)
+    {
+        std::future<int> ahead = std::async(std::launch::async, decode, std::ref(next));
+        std::atomic<size_t> nextRun(0);
+        auto work = [&]
+        {
+            for (size_t k = nextRun++; k < runs.size(); k = nextRun++)
+            {
+                SweepRun &r = *runs[k];
+                std::chrono::steady_clock::time_point s0 = std::chrono::steady_clock::now();
+                for (int f = 0; f < n; ++f)
+                {
+                    r.detector->detect(cur[f], r.boxes);
+                    r.frameBoxes.clear();
+                    for (const cv::Rect &b : r.boxes)
+                        r.frameBoxes.push_back(EvalBox{(double)b.x, (double)b.y, (double)(b.x + b.width), (double)(b.y + b.height)});
+                    r.pred.appendFrame(r.frameBoxes.data(), (int)r.frameBoxes.size());
+                }
+                r.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s0).count();
+            }
+        };
+        std::vector<std::thread> pool;
+        for (int w = 1; w < workers; ++w)
+            pool.emplace_back(work);
+        work();
+        for (auto &t : pool)
+            t.join();
+        n = ahead.get();
+        std::swap(cur, next);
+    }
+    const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (decoded == 0)
+    {
+        std::cerr << "No frames decoded from " << video << "\n";
+        return 2;
+    }
+
+    // Reference frames outside the decoded range would only add misses common to every configuration.
+    const FrameBoxes gtRange = gt.slice(runs[0]->pred.firstFrame, runs[0]->pred.firstFrame + decoded);
+    for (auto &r : runs)
+        r->score = evaluate(r->pred, gtRange, std::vector<double>(1, iouThr))[0];
+    std::stable_sort(runs.begin(), runs.end(), [](const std::unique_ptr<SweepRun> &a, const std::unique_ptr<SweepRun> &b)
+                     { return a->score.f1() > b->score.f1(); });
+
+    std::cout << decoded << " frames, " << runs.size() << " configurations in " << std::fixed << std::setprecision(1) << wall
+              << " s (" << (wall > 0 ? decoded * runs.size() / wall : 0.0) << " config-frames/s), IoU >= "
+              << std::setprecision(2) << iouThr << "\n";
+    std::cout << "rank      F1  Precision  Recall   mIoU       TP       FP       FN  ms/frame  configuration\n";
+    for (size_t k = 0; k < runs.size(); ++k)
+    {
+        const SweepRun &r = *runs[k];
+        std::cout << std::setw(4) << (k + 1) << std::setprecision(3) << std::setw(8) << r.score.f1()
+                  << std::setw(11) << r.score.precision() << std::setw(8) << r.score.recall() << std::setw(7) << r.score.meanIou()
+                  << std::setw(9) << r.score.tp << std::setw(9) << r.score.fp << std::setw(9) << r.score.fn
+                  << std::setprecision(2) << std::setw(10) << r.ms / decoded << "  " << r.name << "\n";
+    }
+    if (!saveDetectorConfig(bestPath, runs[0]->cfg))
+    {
+        std::cerr << "Cannot write " << bestPath << "\n";
+        return 1;
+    }
+    std::cout << "Best configuration written to " << bestPath << "\n";
+    return 0;
+}
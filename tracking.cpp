@@ -0,0 +1,120 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#include "tracking.h"
+#include <algorithm>
+#include <climits>
+
+static const int CONFIRM_HITS=3;
+static const int MAX_LOST=15;          // frames a confirmed track may coast before it is dropped
+static const float GATE_PX=50.0f;      // centre distance gate, same radius as the old nearest-box match
+static const float MIN_IOU=0.1f;
+static const int GRID_CELL=64;
+
+static cv::Rect boxFromState(const cv::Mat &s){
+    float cx=s.at<float>(0), cy=s.at<float>(1), w=std::max(1.0f,s.at<float>(2)), h=std::max(1.0f,s.at<float>(3));
+    return cv::Rect(cvRound(cx-w*0.5f),cvRound(cy-h*0.5f),cvRound(w),cvRound(h));
+}
+
+static float iouOf(const cv::Rect &a,const cv::Rect &b){
+    float inter=(float)(a&b).area(), uni=(float)a.area()+(float)b.area()-inter;
+    return uni>0?inter/uni:0.0f;
+}
+
+PlayerTracker::PlayerTracker():nextId(0){}
+
+void PlayerTracker::spawn(const cv::Rect &box){
+    Track t; t.id=nextId++; t.state=TRACK_TENTATIVE; t.hits=1; t.misses=0; t.box=box; t.team=-1;
+    t.feature=cv::Vec3f(0,0,0); t.featureAge=0; t.hasFeature=false;
+    t.kf.init(6,4,0,CV_32F);
+    cv::setIdentity(t.kf.transitionMatrix);
+    t.kf.transitionMatrix.at<float>(0,4)=1.0f; t.kf.transitionMatrix.at<float>(1,5)=1.0f;
+    cv::setIdentity(t.kf.measurementMatrix);
+    cv::setIdentity(t.kf.processNoiseCov,cv::Scalar::all(1.0f));
+    t.kf.processNoiseCov.at<float>(4,4)=0.25f; t.kf.processNoiseCov.at<float>(5,5)=0.25f;
+    cv::setIdentity(t.kf.measurementNoiseCov,cv::Scalar::all(4.0f));
+    cv::setIdentity(t.kf.errorCovPost,cv::Scalar::all(10.0f));
+    t.kf.errorCovPost.at<float>(4,4)=100.0f; t.kf.errorCovPost.at<float>(5,5)=100.0f;
+    t.kf.statePost.at<float>(0)=box.x+box.width*0.5f; t.kf.statePost.at<float>(1)=box.y+box.height*0.5f;
+    t.kf.statePost.at<float>(2)=(float)box.width; t.kf.statePost.at<float>(3)=(float)box.height;
+    trackList.push_back(t);
+}
+
+void PlayerTracker::update(const std::vector<cv::Rect> &boxes,std::vector<int> &trackOf){
+    const int nt=(int)trackList.size(), nd=(int)boxes.size();
+    predicted.resize(nt);
+    for(int k=0;k<nt;k++) predicted[k]=boxFromState(trackList[k].kf.predict());
+
+    // Candidate pairs: only tracks in grid cells within the gate of a box are scored.
+    pairs.clear();
+    if(nt>0&&nd>0){
+        int minX=INT_MAX,minY=INT_MAX,maxX=INT_MIN,maxY=INT_MIN;
+        for(int k=0;k<nt;k++){
+            minX=std::min(minX,predicted[k].x); minY=std::min(minY,predicted[k].y);
+            maxX=std::max(maxX,predicted[k].br().x); maxY=std::max(maxY,predicted[k].br().y);
+        }
+        const int gw=(maxX-minX)/GRID_CELL+1, gh=(maxY-minY)/GRID_CELL+1;
+        grid.build(predicted,minX,minY,GRID_CELL,gw,gh);
+        for(int i=0;i<nd;i++){
+            const cv::Rect &b=boxes[i]; int g=(int)GATE_PX,c0,r0,c1,r1;
+            if(b.br().x+g<minX||b.x-g>maxX||b.br().y+g<minY||b.y-g>maxY) continue;
+            grid.cellSpan(b.x-g,b.y-g,b.br().x+g,b.br().y+g,c0,r0,c1,r1);
+            cv::Point2f cb(b.x+b.width*0.5f,b.y+b.height*0.5f);
+            for(int r=r0;r<=r1;r++) for(int c=c0;c<=c1;c++) for(const int *p=grid.cellBegin(c,r);p!=grid.cellEnd(c,r);++p){
+                const cv::Rect &t=predicted[*p];
+                // A track spanning several cells is seen more than once; score it from its first cell only.
+                int tc0,tr0,tc1,tr1; grid.cellSpan(t.x,t.y,t.x,t.y,tc0,tr0,tc1,tr1);
+                if(std::max(tc0,c0)!=c||std::max(tr0,r0)!=r) continue;
+                float iou=iouOf(b,t);
+                float dist=(float)cv::norm(cb-cv::Point2f(t.x+t.width*0.5f,t.y+t.height*0.5f));
+                if(iou<MIN_IOU&&dist>=GATE_PX) continue;
+                pairs.push_back(std::make_pair(iou+(1.0f-dist/(GATE_PX*4))*1e-3f,std::make_pair(i,*p)));
+            }
+        }
+        std::sort(pairs.begin(),pairs.end(),[](const std::pair<float,std::pair<int,int> > &a,const std::pair<float,std::pair<int,int> > &b){ return a.first>b.first; });
+    }
+    detTrack.assign(nd,-1); trackDet.assign(nt,-1);
+    for(size_t k=0;k<pairs.size();k++){
+        int i=pairs[k].second.first, t=pairs[k].second.second;
+        if(detTrack[i]!=-1||trackDet[t]!=-1) continue;
+        detTrack[i]=t; trackDet[t]=i;
+    }
+
+    // Lifecycle, then drop dead tracks while remembering where the survivors moved.
+    remap.assign(nt,-1); int kept=0;
+    for(int k=0;k<nt;k++){
+        Track &t=trackList[k];
+        if(trackDet[k]!=-1){
+            const cv::Rect &b=boxes[trackDet[k]];
+            cv::Mat m=(cv::Mat_<float>(4,1)<<b.x+b.width*0.5f,b.y+b.height*0.5f,(float)b.width,(float)b.height);
+            t.kf.correct(m); t.box=b; t.hits++; t.misses=0;
+            if(t.state==TRACK_LOST||(t.state==TRACK_TENTATIVE&&t.hits>=CONFIRM_HITS)) t.state=TRACK_CONFIRMED;
+        }else{
+            t.box=predicted[k]; t.misses++;
+            if(t.state==TRACK_TENTATIVE||t.misses>MAX_LOST) continue;
+            t.state=TRACK_LOST;
+        }
+        t.featureAge++;
+        if(kept!=k) trackList[kept]=trackList[k];
+        remap[k]=kept++;
+    }
+    trackList.resize(kept);
+    trackOf.resize(nd);
+    for(int i=0;i<nd;i++){
+        if(detTrack[i]!=-1) trackOf[i]=remap[detTrack[i]];
+        else{ spawn(boxes[i]); trackOf[i]=(int)trackList.size()-1; }
+    }
+}
+
+void PlayerTracker::coast(int frames){
+    for(size_t k=0;k<trackList.size();k++){
+        Track &t=trackList[k];
+        for(int i=0;i<frames;i++) t.box=boxFromState(t.kf.predict());
+        t.featureAge+=frames;
+    }
+}
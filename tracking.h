@@ -0,0 +1,42 @@
+/********************************************************************************
+  Project: Sport Video Analisis
+  Author: Pooya Nasiri (Student ID: 2071437)
+  Course: Computer Vision — University of Padova
+  Instructor: Prof. Stefano Ghidoni
+  Notes: Original work by the author. Built with C++17 and OpenCV on the official Virtual Lab.
+         No external source code beyond standard libraries and OpenCV.
+********************************************************************************/
+#ifndef TRACKING_H
+#define TRACKING_H
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "detection.h"
+
+// TENTATIVE until it has been matched on CONFIRM_HITS frames, LOST while coasting on its Kalman
+// prediction after a miss; a lost track can still be matched again until it times out.
+enum TrackState{ TRACK_TENTATIVE, TRACK_CONFIRMED, TRACK_LOST };
+
+struct Track{
+    int id; TrackState state; int hits,misses;
+    cv::KalmanFilter kf; cv::Rect box;          // state (cx,cy,w,h,vx,vy), last corrected or predicted box
+    int team;                                   // -1 until the classifier assigns one
+    cv::Vec3f feature; cv::Size featureSize; int featureAge; bool hasFeature; // cached jersey colour
+};
+
+class PlayerTracker{
+    std::vector<Track> trackList; int nextId;
+    std::vector<cv::Rect> predicted; BoxGrid grid;
+    std::vector<std::pair<float,std::pair<int,int> > > pairs; std::vector<int> detTrack,trackDet,remap;
+    void spawn(const cv::Rect &box);
+public:
+    PlayerTracker();
+    // Predicts every track, associates boxes greedily by IoU (centre distance breaks ties and
+    // catches small fast boxes), updates the lifecycle and spawns tracks for unmatched boxes.
+    // trackOf[i] is the index in tracks() of the track now owning boxes[i].
+    void update(const std::vector<cv::Rect> &boxes,std::vector<int> &trackOf);
+    // Frames that were never looked at (dropped in live mode): every track moves on its prediction
+    // without counting a miss, so velocities stay per frame.
+    void coast(int frames);
+    std::vector<Track> &tracks(){ return trackList; }
+};
+#endif